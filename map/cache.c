@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cache.h"
+#include "map_hash.h"
+
+#define INITIAL_CAPACITY 16
+#define VARIATION_CAPACITY 2
+#define MAX_CHARGE_FACTOR 0.65
+#define MAX_TABLE_CAPACITY ((size_t)1 << 31)
+#define INLINE_KEY_SIZE 16
+#define NO_ENTRY UINT32_MAX
+#define NOT_PINNED SIZE_MAX
+
+/******************** structure definition ********************/
+
+typedef enum {
+    EMPTY = 0,
+    TAKEN
+} state_t;
+
+/* An entry of the table, which takes 64 bytes. The keys shorter than INLINE_KEY_SIZE are
+stored inside the entry, and the longer ones are allocated on their own. The recency list of
+CACHE_LRU is linked through the indexes of the entries used just before (`older`) and after
+(`newer`) each one, and CACHE_CLOCK only uses the `used` mark. */
+typedef struct entry {
+    union {
+        char *stored;
+        char inlined[INLINE_KEY_SIZE];
+    } key;
+    void *value;
+    uint64_t hash;
+    size_t charge;
+    uint32_t newer;
+    uint32_t older;
+    uint32_t len;
+    state_t state;
+    bool used;
+} entry_t;
+
+/* The table uses linear probing, and a removed entry is filled by shifting back the entries
+that follow it instead of being marked as deleted, since a full Cache removes a pair for
+each one it adds. The capacity is always a power of two, and at most MAX_TABLE_CAPACITY so
+that any index fits in the links of the entries. `pinned` is the index of the pair being
+put, which is never evicted to make room for itself. */
+struct cache_t {
+    entry_t *table;
+    size_t capacity;
+    size_t size;
+    size_t charge;
+    size_t max_charge;
+    cache_policy_t policy;
+    uint32_t newest;
+    uint32_t oldest;
+    size_t hand;
+    size_t pinned;
+    destroy_func_t destroy;
+    uint64_t seed;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+/******************** static functions declarations ********************/
+
+static bool cache_table_resize(Cache cache, size_t new_capacity);
+static size_t cache_place(Cache cache, const entry_t *entry);
+static size_t cache_search(Cache cache, const char *key, size_t len, uint64_t h);
+static void cache_touch(Cache cache, size_t index);
+static void cache_link_newest(Cache cache, size_t index);
+static void cache_unlink(Cache cache, size_t index);
+static void cache_evict(Cache cache);
+static size_t cache_victim(Cache cache);
+static void cache_remove_entry(Cache cache, size_t index);
+static void cache_move(Cache cache, size_t from, size_t to);
+static const char *entry_key(const entry_t *entry);
+
+/******************** Cache operations definitions ********************/
+
+Cache cache_create(size_t capacity, cache_policy_t policy, destroy_func_t value_destroy) {
+    if (capacity == 0) return NULL;
+
+    Cache cache = (Cache)malloc(sizeof(struct cache_t));
+    if (cache == NULL) return NULL;
+
+    cache->table = (entry_t*)calloc(INITIAL_CAPACITY, sizeof(entry_t));
+    if (cache->table == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->capacity = INITIAL_CAPACITY;
+    cache->size = 0;
+    cache->charge = 0;
+    cache->max_charge = capacity;
+    cache->policy = policy;
+    cache->newest = NO_ENTRY;
+    cache->oldest = NO_ENTRY;
+    cache->hand = 0;
+    cache->pinned = NOT_PINNED;
+    cache->destroy = value_destroy;
+    cache->seed = hash_random_seed();
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+
+    return cache;
+}
+
+void cache_destroy(Cache cache) {
+    if (cache == NULL) return;
+
+    for (size_t i = 0 ; i < cache->capacity ; i++) {
+        entry_t *current = &cache->table[i];
+        if (current->state != TAKEN) continue;
+
+        if (cache->destroy != NULL) (cache->destroy)(current->value);
+        if (current->len >= INLINE_KEY_SIZE) free(current->key.stored);
+    }
+    free(cache->table);
+    free(cache);
+}
+
+size_t cache_size(Cache cache) {
+    return cache != NULL ? cache->size : 0;
+}
+
+bool cache_put(Cache cache, const char *key, void *value) {
+    return cache_put_charged(cache, key, value, 1);
+}
+
+bool cache_put_charged(Cache cache, const char *key, void *value, size_t charge) {
+    if (cache == NULL || charge > cache->max_charge) return false;
+
+    float charge_factor = (float)(cache->size + 1) / (float)cache->capacity;
+    if (charge_factor > MAX_CHARGE_FACTOR) if (!cache_table_resize(cache, cache->capacity * VARIATION_CAPACITY)) return false;
+
+    size_t len = strlen(key);
+    uint64_t h = hash_wy(key, len, cache->seed);
+    size_t index = cache_search(cache, key, len, h);
+    entry_t *entry = &cache->table[index];
+
+    if (entry->state == TAKEN) {
+        if (cache->destroy != NULL) (cache->destroy)(entry->value);
+        cache->charge -= entry->charge;
+        cache_touch(cache, index);
+    } else {
+        if (len >= INLINE_KEY_SIZE) {
+            char *copy = (char*)malloc(len + 1);
+            if (copy == NULL) return false;
+            memcpy(copy, key, len + 1);
+            entry->key.stored = copy;
+        } else {
+            memcpy(entry->key.inlined, key, len + 1);
+        }
+
+        entry->hash = h;
+        entry->len = (uint32_t)len;
+        entry->state = TAKEN;
+        entry->used = false;
+        if (cache->policy == CACHE_LRU) cache_link_newest(cache, index);
+        cache->size++;
+    }
+    entry->value = value;
+    entry->charge = charge;
+    cache->charge += charge;
+
+    // The charge of the pinned pair fits in the Cache, so there is always another pair to evict
+    cache->pinned = index;
+    while (cache->charge > cache->max_charge) cache_evict(cache);
+    cache->pinned = NOT_PINNED;
+
+    return true;
+}
+
+void *cache_get(Cache cache, const char *key) {
+    if (cache == NULL) return NULL;
+
+    size_t len = strlen(key);
+    size_t index = cache_search(cache, key, len, hash_wy(key, len, cache->seed));
+    if (cache->table[index].state != TAKEN) {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    cache_touch(cache, index);
+
+    return cache->table[index].value;
+}
+
+bool cache_contains(Cache cache, const char *key) {
+    if (cache == NULL) return false;
+
+    size_t len = strlen(key);
+
+    return cache->table[cache_search(cache, key, len, hash_wy(key, len, cache->seed))].state == TAKEN;
+}
+
+void *cache_remove(Cache cache, const char *key) {
+    if (cache == NULL) return NULL;
+
+    size_t len = strlen(key);
+    size_t index = cache_search(cache, key, len, hash_wy(key, len, cache->seed));
+    if (cache->table[index].state != TAKEN) return NULL;
+
+    void *value = cache->table[index].value;
+    cache_remove_entry(cache, index);
+
+    return value;
+}
+
+void cache_for_each(Cache cache, visit_func_t visit, void *extra) {
+    if (cache == NULL) return;
+
+    for (size_t i = 0 ; i < cache->capacity ; i++) {
+        entry_t *current = &cache->table[i];
+        if (current->state == TAKEN && !visit(entry_key(current), current->value, extra)) break;
+    }
+}
+
+void cache_stats(Cache cache, cache_stats_t *stats) {
+    if (stats == NULL) return;
+
+    memset(stats, 0, sizeof(cache_stats_t));
+    if (cache == NULL) return;
+
+    stats->size = cache->size;
+    stats->charge = cache->charge;
+    stats->capacity = cache->max_charge;
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+}
+
+/******************** static functions definitions ********************/
+
+/* The entries are moved with their stored hash. For CACHE_LRU they are placed from the
+oldest to the newest, so the recency list is linked again in the same order. */
+static bool cache_table_resize(Cache cache, size_t new_capacity) {
+    if (new_capacity > MAX_TABLE_CAPACITY) return false;
+
+    entry_t *new_table = (entry_t*)calloc(new_capacity, sizeof(entry_t));
+    if (new_table == NULL) return false;
+
+    entry_t *old_table = cache->table;
+    size_t old_capacity = cache->capacity;
+    uint32_t oldest = cache->oldest;
+
+    cache->table = new_table;
+    cache->capacity = new_capacity;
+    cache->newest = NO_ENTRY;
+    cache->oldest = NO_ENTRY;
+    cache->hand = 0;
+
+    if (cache->policy == CACHE_LRU) {
+        for (uint32_t i = oldest ; i != NO_ENTRY ; i = old_table[i].newer) cache_link_newest(cache, cache_place(cache, &old_table[i]));
+    } else {
+        for (size_t i = 0 ; i < old_capacity ; i++) {
+            if (old_table[i].state == TAKEN) cache_place(cache, &old_table[i]);
+        }
+    }
+    free(old_table);
+
+    return true;
+}
+
+// Copies the entry into the first empty slot from its expected index, and returns its index
+static size_t cache_place(Cache cache, const entry_t *entry) {
+    size_t index = (size_t)entry->hash & (cache->capacity-1);
+    while (cache->table[index].state != EMPTY) index = (index+1) & (cache->capacity-1);
+    cache->table[index] = *entry;
+
+    return index;
+}
+
+// Returns the index of the entry of the key, or of the empty slot where it would be
+static size_t cache_search(Cache cache, const char *key, size_t len, uint64_t h) {
+    size_t index = (size_t)h & (cache->capacity-1);
+
+    for ( ; cache->table[index].state != EMPTY ; index = (index+1) & (cache->capacity-1)) {
+        entry_t *current = &cache->table[index];
+        if (current->hash == h && current->len == len && memcmp(entry_key(current), key, len) == 0) return index;
+    }
+
+    return index;
+}
+
+static void cache_touch(Cache cache, size_t index) {
+    if (cache->policy == CACHE_CLOCK) {
+        cache->table[index].used = true;
+    } else if (cache->newest != index) {
+        cache_unlink(cache, index);
+        cache_link_newest(cache, index);
+    }
+}
+
+static void cache_link_newest(Cache cache, size_t index) {
+    entry_t *entry = &cache->table[index];
+
+    entry->newer = NO_ENTRY;
+    entry->older = cache->newest;
+    if (cache->newest != NO_ENTRY) cache->table[cache->newest].newer = (uint32_t)index;
+    else cache->oldest = (uint32_t)index;
+    cache->newest = (uint32_t)index;
+}
+
+static void cache_unlink(Cache cache, size_t index) {
+    entry_t *entry = &cache->table[index];
+
+    if (entry->newer != NO_ENTRY) cache->table[entry->newer].older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older != NO_ENTRY) cache->table[entry->older].newer = entry->newer;
+    else cache->oldest = entry->newer;
+}
+
+static void cache_evict(Cache cache) {
+    size_t index = cache_victim(cache);
+    void *value = cache->table[index].value;
+
+    cache_remove_entry(cache, index);
+    cache->evictions++;
+    if (cache->destroy != NULL) (cache->destroy)(value);
+}
+
+/* Returns the index of the pair to evict. The pinned pair is the newest one for CACHE_LRU,
+so it is never the oldest while another pair is stored; for CACHE_CLOCK, the hand skips it. */
+static size_t cache_victim(Cache cache) {
+    if (cache->policy == CACHE_LRU) return cache->oldest;
+
+    for ( ; ; cache->hand = (cache->hand + 1) & (cache->capacity-1)) {
+        entry_t *current = &cache->table[cache->hand];
+        if (current->state != TAKEN || cache->hand == cache->pinned) continue;
+
+        if (!current->used) return cache->hand;
+        current->used = false;
+    }
+}
+
+/* Removes the entry and shifts back each following entry that can be moved into the empty
+slot, that is, whose expected index is not between the empty slot and itself. */
+static void cache_remove_entry(Cache cache, size_t index) {
+    entry_t *entry = &cache->table[index];
+
+    if (cache->policy == CACHE_LRU) cache_unlink(cache, index);
+    if (entry->len >= INLINE_KEY_SIZE) free(entry->key.stored);
+    cache->charge -= entry->charge;
+    cache->size--;
+
+    size_t mask = cache->capacity - 1;
+    for (size_t next = (index+1) & mask ; cache->table[next].state == TAKEN ; next = (next+1) & mask) {
+        size_t expected = (size_t)cache->table[next].hash & mask;
+        if (((next - expected) & mask) < ((next - index) & mask)) continue;
+
+        cache_move(cache, next, index);
+        index = next;
+    }
+    cache->table[index].state = EMPTY;
+}
+
+// Moves an entry into an empty slot, updating the links and the pin that point to it
+static void cache_move(Cache cache, size_t from, size_t to) {
+    entry_t *entry = &cache->table[to];
+    *entry = cache->table[from];
+
+    if (cache->pinned == from) cache->pinned = to;
+    if (cache->policy == CACHE_CLOCK) return;
+
+    if (entry->newer != NO_ENTRY) cache->table[entry->newer].older = (uint32_t)to;
+    else cache->newest = (uint32_t)to;
+    if (entry->older != NO_ENTRY) cache->table[entry->older].newer = (uint32_t)to;
+    else cache->oldest = (uint32_t)to;
+}
+
+static const char *entry_key(const entry_t *entry) {
+    return entry->len < INLINE_KEY_SIZE ? entry->key.inlined : entry->key.stored;
+}
+
@@ -0,0 +1,92 @@
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+
+/******************** Cache structures declarations ********************/
+
+/* How the Cache chooses the pair to evict when it is full:
+- CACHE_LRU evicts the least recently used pair. Each get moves its pair to the front of a
+list kept inside the table.
+- CACHE_CLOCK evicts a pair that was not used since the last time the clock hand went past
+it. Each get only marks its pair as used, so a hit does not write to any other pair. */
+typedef enum {
+    CACHE_LRU,
+    CACHE_CLOCK
+} cache_policy_t;
+// A snapshot of how a Cache is being used
+typedef struct cache_stats {
+    size_t size;
+    // The sum of the charges of the stored pairs, and the most that the Cache can store
+    size_t charge;
+    size_t capacity;
+    // The gets that found their key, the ones that did not, and the pairs evicted to make room
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} cache_stats_t;
+/* A data structure that stores `key-value` pairs up to a capacity, evicting the pairs that
+are least likely to be used again to make room for the new ones. */
+typedef struct cache_t *Cache;
+
+/******************** Cache operations declarations ********************/
+
+/* Returns an instance of an empty Cache.
+
+PRE:
+- `capacity` is the most that the charges of the stored pairs can add up to. Each pair put
+with `cache_put` is charged 1, so it is the most pairs the Cache can store; the pairs put
+with `cache_put_charged` can be charged their size in bytes instead.
+- `value_destroy` is called for the value of each pair that is evicted or replaced, and for
+the values left in the Cache when it is destroyed. If NULL is given, it is not called.
+
+POST:
+- if `capacity` is 0 or there is not enough memory for the Cache, the function will return
+NULL. */
+Cache cache_create(size_t capacity, cache_policy_t policy, destroy_func_t value_destroy);
+
+/* Frees the memory where the Cache is allocated. */
+void cache_destroy(Cache cache);
+
+/* Returns the amount of pairs stored in the Cache. */
+size_t cache_size(Cache cache);
+
+/* If the key is not stored in the Cache, adds the `key-value` pair to it; otherwise, updates
+the value of the pair, which counts as a use. If the Cache is full, the pairs chosen by its
+policy are evicted until the pair fits, but never the pair that is put.
+
+POST:
+- Returns true if the pair was stored, and false if there is not enough memory for it, in
+which case the Cache does not change. */
+bool cache_put(Cache cache, const char *key, void *value);
+
+/* Works like `cache_put`, but the pair is charged `charge` instead of 1.
+
+POST:
+- Returns false if `charge` is greater than the capacity of the Cache, in which case the
+Cache does not change. */
+bool cache_put_charged(Cache cache, const char *key, void *value, size_t charge);
+
+/* Returns the value of the pair for the given key, and counts it as a use of the pair and as
+a hit; if the key is not stored in the Cache, returns NULL and counts a miss. */
+void *cache_get(Cache cache, const char *key);
+
+/* Returns true if the key is stored in the Cache, false if not. It is not counted as a use
+of the pair, nor as a hit or a miss. */
+bool cache_contains(Cache cache, const char *key);
+
+/* Remove and return the value of the pair with the given key. The value is not destroyed.
+
+POST:
+- If the key is not stored in the Cache, the function returns NULL. */
+void *cache_remove(Cache cache, const char *key);
+
+/* Works like `map_for_each`, and does not count as a use of the pairs it visits. */
+void cache_for_each(Cache cache, visit_func_t visit, void *extra);
+
+/* Fills `stats` with the current state of the Cache. */
+void cache_stats(Cache cache, cache_stats_t *stats);
+
+#endif // _CACHE_H
@@ -0,0 +1,551 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "map.h"
+#include "map_hash.h"
+#include "map_filter.h"
+
+#define INITIAL_CAPACITY 16
+#define INITIAL_ENTRIES 8
+#define VARIATION_CAPACITY 2
+#define MIN_CHARGE_FACTOR 0.15
+#define MAX_CHARGE_FACTOR 0.65
+#define MAX_CAPACITY ((size_t)1 << 31)
+#define INLINE_KEY_SIZE 16
+
+#define SLOT_EMPTY -1
+#define SLOT_DELETED -2
+
+#define VALUE_ALIGNMENT 8
+#define BATCH_SIZE 16
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/******************** structure definition ********************/ 
+
+typedef enum {
+    TAKEN = 0,
+    DELETED
+} state_t;
+
+/* The pairs are stored in the entries, one after the other in the order they were added.
+The hash of the key is stored with the pair, so the keys are only compared when the hashes
+match and the table can be rebuilt without hashing the keys again. The keys shorter than
+INLINE_KEY_SIZE are stored inside the entry, and the longer ones are allocated on their own. */
+typedef struct entry {
+    union {
+        char *stored;
+        char inlined[INLINE_KEY_SIZE];
+    } key;
+    void *value;
+    uint64_t hash;
+    uint32_t len;
+    state_t state;
+} entry_t;
+
+/* Each slot of the table only has the index of its entry, or SLOT_EMPTY or SLOT_DELETED, so
+an empty slot takes 4 bytes. The capacity is always a power of two, and at most MAX_CAPACITY
+so that the index of every entry fits in a slot. `used` entries were added since the entries
+were last compacted: a removed pair stays in its entry, marked as deleted, until the removed
+pairs outnumber the stored ones or the table is rebuilt, so the others keep their order and
+an iteration goes through less than twice as many entries as pairs. Each entry takes
+`stride` bytes: a Map created by `map_create_sized` stores `value_size` bytes of value right
+after each entry, and `removed` has room for a copy of the last removed value. */
+struct hash_t {
+    int32_t *table;
+    size_t capacity;
+    size_t size;
+    size_t deleted;
+    entry_t *entries;
+    size_t used;
+    size_t entries_capacity;
+    size_t value_size;
+    size_t stride;
+    void *removed;
+    filter_t filter;
+    destroy_func_t destroy;
+    hash_func_t hash_func;
+    uint64_t seed;
+    map_stats_t stats;
+};
+
+/******************** static functions declarations ********************/ 
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount);
+static int32_t *hash_table_create(size_t capacity);
+static bool hash_table_rebuild(Map hash, size_t new_capacity);
+static bool hash_entries_reserve(Map hash, size_t amount);
+static void hash_entries_compact(Map hash);
+static entry_t *hash_entry(Map hash, size_t index);
+static void *entry_value(Map hash, entry_t *entry);
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h);
+static size_t hash_slot_of(Map hash, uint64_t h, size_t index);
+static size_t hash_expected_index(uint64_t h, size_t capacity);
+static bool entry_store_key(entry_t *entry, const void *key, size_t len);
+static void entry_release_key(entry_t *entry);
+static const char *entry_key(const entry_t *entry);
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found);
+static size_t hash_capacity_for(size_t amount);
+static void next_iter_index(MapIterator iter);
+
+// The operations that every implementation defines in the same way
+#include "map_common.h"
+
+/******************** Map operations definitions ********************/
+
+void map_destroy(Map hash) {
+    if (hash == NULL) return;
+
+    for (size_t i = 0 ; i < hash->used ; i++) {
+        entry_t *current = hash_entry(hash, i);
+        if (current->state != TAKEN) continue;
+
+        if (hash->destroy != NULL) (hash->destroy)(entry_value(hash, current));
+        entry_release_key(current);
+    }
+    free(hash->entries);
+    free(hash->table);
+    free(hash->filter.memory);
+    free(hash->removed);
+    free(hash);
+}
+
+bool map_reserve(Map hash, size_t amount) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(amount);
+    if (new_capacity == 0) return false;
+    if (new_capacity > hash->capacity && !hash_table_rebuild(hash, new_capacity)) return false;
+
+    return amount <= hash->size || hash_entries_reserve(hash, hash->used + amount - hash->size);
+}
+
+bool map_shrink_to_fit(Map hash) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(hash->size);
+    if (new_capacity < hash->capacity && !hash_table_rebuild(hash, new_capacity)) return false;
+    if (hash->used > hash->size) hash_entries_compact(hash);
+
+    // The entries are only given back to the system, so the Map does not change if it fails
+    if (hash->size == 0) {
+        free(hash->entries);
+        hash->entries = NULL;
+        hash->entries_capacity = 0;
+    } else if (hash->size < hash->entries_capacity) {
+        entry_t *entries = (entry_t*)realloc(hash->entries, hash->size * hash->stride);
+        if (entries != NULL) {
+            hash->entries = entries;
+            hash->entries_capacity = hash->size;
+        }
+    }
+
+    return true;
+}
+
+bool map_enable_filter(Map hash) {
+    if (hash == NULL) return false;
+    if (hash->filter.memory != NULL) return true;
+
+    if (!filter_create(&hash->filter, hash->capacity)) return false;
+    for (size_t i = 0 ; i < hash->used ; i++) {
+        entry_t *current = hash_entry(hash, i);
+        if (current->state == TAKEN) filter_update(&hash->filter, current->hash, true);
+    }
+
+    return true;
+}
+
+void **map_entry_n(Map hash, const void *key, size_t len, bool *inserted) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.puts);
+    float charge_factor = (float)(hash->size + hash->deleted) / (float)hash->capacity;
+    if (charge_factor > MAX_CHARGE_FACTOR) {
+        // When most of the load are deleted slots, the table is rebuilt with the same capacity
+        bool purge = (float)(hash->size + 1) / (float)hash->capacity <= MAX_CHARGE_FACTOR / VARIATION_CAPACITY;
+        if (!hash_table_rebuild(hash, purge ? hash->capacity : hash->capacity * VARIATION_CAPACITY)) return NULL;
+    }
+
+    uint64_t h = hash_key(hash, key, len);
+    size_t slot = hash_search(hash, key, len, h);
+    bool is_new = hash->table[slot] == SLOT_EMPTY;
+    entry_t *entry;
+
+    if (is_new) {
+        if (!hash_entries_reserve(hash, hash->used + 1)) return NULL;
+        entry = hash_entry(hash, hash->used);
+        if (!entry_store_key(entry, key, len)) return NULL;
+
+        entry->hash = h;
+        entry->state = TAKEN;
+        entry->value = NULL;
+        if (hash->value_size != 0) memset(entry_value(hash, entry), 0, hash->value_size);
+        if (hash->filter.memory != NULL) filter_update(&hash->filter, h, true);
+        hash->table[slot] = (int32_t)hash->used;
+        hash->used++;
+        hash->size++;
+    } else {
+        entry = hash_entry(hash, (size_t)hash->table[slot]);
+    }
+    if (inserted != NULL) *inserted = is_new;
+
+    return hash->value_size != 0 ? (void**)entry_value(hash, entry) : &entry->value;
+}
+
+bool map_contains_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return false;
+
+    COUNT(hash->stats.gets);
+    uint64_t h = hash_key(hash, key, len);
+    if (!filter_contains(&hash->filter, h)) return false;
+
+    return hash->table[hash_search(hash, key, len, h)] >= 0;
+}
+
+void *map_get_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.gets);
+    uint64_t h = hash_key(hash, key, len);
+    if (!filter_contains(&hash->filter, h)) return NULL;
+
+    int32_t index = hash->table[hash_search(hash, key, len, h)];
+
+    return index >= 0 ? entry_value(hash, hash_entry(hash, (size_t)index)) : NULL;
+}
+
+void *map_remove_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.removes);
+    uint64_t h = hash_key(hash, key, len);
+    if (!filter_contains(&hash->filter, h)) return NULL;
+
+    size_t slot = hash_search(hash, key, len, h);
+    if (hash->table[slot] < 0) return NULL;
+    if (hash->filter.memory != NULL) filter_update(&hash->filter, h, false);
+
+    entry_t *entry = hash_entry(hash, (size_t)hash->table[slot]);
+    hash->table[slot] = SLOT_DELETED;
+    hash->size--;
+    hash->deleted++;
+    entry->state = DELETED;
+    entry_release_key(entry);
+    void *deleted = entry->value;
+    if (hash->value_size != 0) deleted = memcpy(hash->removed, entry_value(hash, entry), hash->value_size);
+
+    float charge_factor = (float)hash->size / (float)hash->capacity;
+    bool shrunk = charge_factor < MIN_CHARGE_FACTOR && hash->capacity >= INITIAL_CAPACITY * VARIATION_CAPACITY && hash_table_rebuild(hash, hash->capacity / VARIATION_CAPACITY);
+    if (!shrunk && hash->used - hash->size > hash->size) hash_entries_compact(hash);
+
+    return deleted;
+}
+
+void map_for_each(Map hash, visit_func_t visit, void *extra) {
+    if (hash == NULL) return;
+
+    entry_t *current;
+    for (size_t i = 0 ; i < hash->used ; i++) {
+        current = hash_entry(hash, i);
+        if (current->state == TAKEN && !visit(entry_key(current), entry_value(hash, current), extra)) break;
+    }
+}
+
+void map_stats(Map hash, map_stats_t *stats) {
+    if (hash == NULL || stats == NULL) return;
+
+    *stats = hash->stats;
+    stats->size = hash->size;
+    stats->capacity = hash->capacity;
+    stats->deleted = hash->deleted;
+
+    size_t total_length = 0;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        if (hash->table[i] < 0) continue;
+
+        entry_t *current = hash_entry(hash, (size_t)hash->table[i]);
+        size_t length = (i - hash_expected_index(current->hash, hash->capacity)) & (hash->capacity-1);
+        stats_add_probe_length(stats, length);
+        total_length += length;
+    }
+    stats->average_probe_length = hash->size > 0 ? (double)total_length / (double)hash->size : 0;
+}
+
+/******************** Map Iterator operations definitions ********************/
+
+bool map_iter_has_next(const MapIterator iter) {
+    return iter != NULL && iter->current_index < iter->hash->used;
+}
+
+const char *map_iter_get_current(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? entry_key(hash_entry(iter->hash, iter->current_index)) : NULL;
+}
+
+void *map_iter_get_value(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? entry_value(iter->hash, hash_entry(iter->hash, iter->current_index)) : NULL;
+}
+
+uint64_t map_iter_get_hash(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_entry(iter->hash, iter->current_index)->hash : 0;
+}
+
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n) {
+    size_t stored = 0;
+
+    for ( ; stored < n && map_iter_has_next(iter) ; stored++) {
+        entry_t *current = hash_entry(iter->hash, iter->current_index);
+        if (keys != NULL) keys[stored] = entry_key(current);
+        if (values != NULL) values[stored] = entry_value(iter->hash, current);
+
+        iter->current_index++;
+        next_iter_index(iter);
+    }
+
+    return stored;
+}
+
+/******************** static functions definitions ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount) {
+    size_t capacity = hash_capacity_for(amount);
+    if (capacity == 0) return NULL;
+
+    Map hash = (Map)malloc(sizeof(struct hash_t));
+    if (hash == NULL) return NULL;
+
+    hash->value_size = value_size;
+    hash->stride = sizeof(entry_t) + (value_size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+    hash->removed = NULL;
+    hash->table = hash_table_create(capacity);
+    if (value_size != 0) hash->removed = malloc(value_size);
+    if (hash->table == NULL || (value_size != 0 && hash->removed == NULL)) {
+        free(hash->table);
+        free(hash->removed);
+        free(hash);
+        return NULL;
+    }
+
+    hash->capacity = capacity;
+    hash->size = 0;
+    hash->deleted = 0;
+    hash->entries = NULL;
+    hash->used = 0;
+    hash->entries_capacity = 0;
+    hash->filter.memory = NULL;
+    hash->filter.blocks = NULL;
+    hash->destroy = value_destroy;
+    hash->hash_func = hash_func != NULL ? hash_func : hash_wy;
+    hash->seed = seed;
+    memset(&hash->stats, 0, sizeof(map_stats_t));
+
+    if (!hash_entries_reserve(hash, amount)) {
+        map_destroy(hash);
+        return NULL;
+    }
+
+    return hash;
+}
+
+// Every byte of an empty slot is 0xFF, which is SLOT_EMPTY
+static int32_t *hash_table_create(size_t capacity) {
+    int32_t *table = (int32_t*)malloc(capacity * sizeof(int32_t));
+    if (table != NULL) memset(table, 0xFF, capacity * sizeof(int32_t));
+
+    return table;
+}
+
+/* Allocates a table with the given capacity and places every entry in it again, compacting
+the entries on the way. The entries are moved with their stored hash, the keys are neither
+copied nor hashed again. */
+static bool hash_table_rebuild(Map hash, size_t new_capacity) {
+    if (new_capacity > MAX_CAPACITY) return false;
+
+    clock_t start = clock();
+    int32_t *new_table = hash_table_create(new_capacity);
+    if (new_table == NULL) return false;
+
+    // The filter is rebuilt for the new capacity, which also clears its saturated counters
+    filter_t new_filter = {NULL, NULL, 0};
+    if (hash->filter.memory != NULL && !filter_create(&new_filter, new_capacity)) {
+        free(new_table);
+        return false;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0 ; i < hash->used ; i++) {
+        entry_t *current = hash_entry(hash, i);
+        if (current->state != TAKEN) continue;
+
+        size_t index = hash_expected_index(current->hash, new_capacity);
+        while (new_table[index] != SLOT_EMPTY) index = (index+1) & (new_capacity-1);
+        new_table[index] = (int32_t)kept;
+        if (new_filter.memory != NULL) filter_update(&new_filter, current->hash, true);
+        if (kept != i) memcpy(hash_entry(hash, kept), current, hash->stride);
+        kept++;
+    }
+    free(hash->table);
+    free(hash->filter.memory);
+    hash->filter = new_filter;
+
+    hash->table = new_table;
+    hash->capacity = new_capacity;
+    hash->deleted = 0;
+    hash->used = kept;
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return true;
+}
+
+// Makes room for `amount` entries in total, at least doubling the room there is
+static bool hash_entries_reserve(Map hash, size_t amount) {
+    if (amount <= hash->entries_capacity) return true;
+
+    size_t new_capacity = hash->entries_capacity * VARIATION_CAPACITY;
+    if (new_capacity < amount) new_capacity = amount;
+    if (new_capacity < INITIAL_ENTRIES) new_capacity = INITIAL_ENTRIES;
+    if (new_capacity > SIZE_MAX / hash->stride) return false;
+
+    entry_t *entries = (entry_t*)realloc(hash->entries, new_capacity * hash->stride);
+    if (entries == NULL) return false;
+
+    hash->entries = entries;
+    hash->entries_capacity = new_capacity;
+
+    return true;
+}
+
+/* Moves the stored entries over the deleted ones, keeping their order, and points their
+slots to their new indexes. The slots of the removed pairs stay deleted, so the table is not
+rebuilt and only the entries are gone through. */
+static void hash_entries_compact(Map hash) {
+    size_t kept = 0;
+
+    for (size_t i = 0 ; i < hash->used ; i++) {
+        entry_t *current = hash_entry(hash, i);
+        if (current->state != TAKEN) continue;
+
+        if (kept != i) {
+            hash->table[hash_slot_of(hash, current->hash, i)] = (int32_t)kept;
+            memcpy(hash_entry(hash, kept), current, hash->stride);
+        }
+        kept++;
+    }
+    hash->used = kept;
+}
+
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h) {
+    size_t index = hash_expected_index(h, hash->capacity);
+
+    for ( ; hash->table[index] != SLOT_EMPTY ; index = (index+1) & (hash->capacity-1)) {
+        COUNT(hash->stats.probes);
+        if (hash->table[index] == SLOT_DELETED) continue;
+
+        entry_t *current = hash_entry(hash, (size_t)hash->table[index]);
+        if (current->hash == h && current->len == len && memcmp(entry_key(current), key, len) == 0) return index;
+    }
+
+    return index;
+}
+
+// Returns the slot that points to the entry with the given index, which must be stored
+static size_t hash_slot_of(Map hash, uint64_t h, size_t index) {
+    size_t slot = hash_expected_index(h, hash->capacity);
+    while (hash->table[slot] != (int32_t)index) slot = (slot+1) & (hash->capacity-1);
+
+    return slot;
+}
+
+static entry_t *hash_entry(Map hash, size_t index) {
+    return (entry_t*)((char*)hash->entries + index * hash->stride);
+}
+
+// Returns the value of the entry, or the address of its bytes if the Map stores them
+static void *entry_value(Map hash, entry_t *entry) {
+    return hash->value_size != 0 ? (void*)(entry + 1) : entry->value;
+}
+
+static size_t hash_expected_index(uint64_t h, size_t capacity) {
+    return (size_t)h & (capacity-1);
+}
+
+// Copies the key followed by a '\0' into the entry if it is short enough, or into its own allocation
+static bool entry_store_key(entry_t *entry, const void *key, size_t len) {
+    if ((uint32_t)len != len) return false;
+
+    char *copy = entry->key.inlined;
+    if (len >= INLINE_KEY_SIZE) {
+        copy = (char*)malloc(len + 1);
+        if (copy == NULL) return false;
+        entry->key.stored = copy;
+    }
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    entry->len = (uint32_t)len;
+
+    return true;
+}
+
+static void entry_release_key(entry_t *entry) {
+    if (entry->len >= INLINE_KEY_SIZE) free(entry->key.stored);
+}
+
+static const char *entry_key(const entry_t *entry) {
+    return entry->len < INLINE_KEY_SIZE ? entry->key.inlined : entry->key.stored;
+}
+
+/* Searches the keys in batches of BATCH_SIZE: first every key of the batch is hashed and the
+memory of its expected slot is prefetched, and then they are searched. Either `values` or
+`found` can be NULL. */
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found) {
+    if (hash == NULL) return 0;
+
+    uint64_t hashes[BATCH_SIZE];
+    size_t lens[BATCH_SIZE];
+    size_t stored = 0;
+
+    for (size_t start = 0 ; start < n ; start += BATCH_SIZE) {
+        size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            lens[i] = strlen(keys[start + i]);
+            hashes[i] = hash_key(hash, keys[start + i], lens[i]);
+            PREFETCH(&hash->table[hash_expected_index(hashes[i], hash->capacity)]);
+        }
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            COUNT(hash->stats.gets);
+            int32_t index = SLOT_EMPTY;
+            if (filter_contains(&hash->filter, hashes[i])) index = hash->table[hash_search(hash, keys[start + i], lens[i], hashes[i])];
+
+            void *value = index >= 0 ? entry_value(hash, hash_entry(hash, (size_t)index)) : NULL;
+            if (values != NULL) values[start + i] = value;
+            if (found != NULL) found[start + i] = index >= 0;
+            if (index >= 0) stored++;
+        }
+    }
+
+    return stored;
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t hash_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_CAPACITY;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
+static void next_iter_index(MapIterator iter) {
+    while (map_iter_has_next(iter) && hash_entry(iter->hash, iter->current_index)->state != TAKEN) iter->current_index++;
+}
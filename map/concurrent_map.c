@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "concurrent_map.h"
+#include "map_hash.h"
+
+#define DEFAULT_STRIPES 64
+#define CACHE_LINE_SIZE 64
+#define BUILDER_BATCH 32
+
+/******************** structure definition ********************/
+
+/* Each stripe takes whole cache lines, so the locks of different stripes are never in the
+same cache line. A stripe only resizes its own Map, so the readers of the other stripes
+never wait for a resize. */
+typedef struct stripe {
+    pthread_rwlock_t lock;
+    Map map;
+    char padding[CACHE_LINE_SIZE - (sizeof(pthread_rwlock_t) + sizeof(Map)) % CACHE_LINE_SIZE];
+} stripe_t;
+
+// The Map of every stripe hashes its keys with `seed`, the one used to choose the stripes
+struct concurrent_map_t {
+    stripe_t *stripes;
+    size_t amount;
+    unsigned shift;
+    uint64_t seed;
+    destroy_func_t value_destroy;
+};
+
+/* The pairs put by a builder that were not moved to the Map of their stripe yet. Their keys
+are copied one after the other into `keys`. */
+typedef struct pending {
+    size_t count;
+    size_t offsets[BUILDER_BATCH];
+    void *values[BUILDER_BATCH];
+    char *keys;
+    size_t keys_size;
+    size_t keys_capacity;
+} pending_t;
+
+struct concurrent_map_builder_t {
+    ConcurrentMap map;
+    pending_t *pending;
+};
+
+// The visit function and its extra parameter, for the iteration of every stripe
+typedef struct visit_state {
+    visit_func_t visit;
+    void *extra;
+    bool stopped;
+} visit_state_t;
+
+// The stripes left to visit by the workers of a parallel iteration
+typedef struct parallel_state {
+    ConcurrentMap map;
+    visit_func_t visit;
+    void *extra;
+    size_t next;
+    bool stopped;
+} parallel_state_t;
+
+/******************** static functions declarations ********************/
+
+static size_t stripe_index(ConcurrentMap map, const char *key);
+static bool visit_until_stopped(const char *key, void *value, void *extra);
+static void *parallel_worker(void *extra);
+static bool parallel_visit(const char *key, void *value, void *extra);
+static bool pending_add(pending_t *pending, const char *key, void *value);
+static bool pending_flush(ConcurrentMap map, size_t index, pending_t *pending);
+
+/******************** Concurrent Map operations definitions ********************/
+
+ConcurrentMap concurrent_map_create(destroy_func_t value_destroy, size_t stripes) {
+    ConcurrentMap map = (ConcurrentMap)malloc(sizeof(struct concurrent_map_t));
+    if (map == NULL) return NULL;
+
+    size_t amount = 1;
+    unsigned bits = 0;
+    for ( ; amount < (stripes != 0 ? stripes : DEFAULT_STRIPES) ; bits++) amount *= 2;
+
+    void *memory = NULL;
+    if (posix_memalign(&memory, CACHE_LINE_SIZE, amount * sizeof(stripe_t)) != 0) {
+        free(map);
+        return NULL;
+    }
+    map->stripes = (stripe_t*)memory;
+    map->amount = 0;
+    map->shift = 64 - bits;
+    map->seed = hash_random_seed();
+    map->value_destroy = value_destroy;
+
+    for ( ; map->amount < amount ; map->amount++) {
+        stripe_t *stripe = &map->stripes[map->amount];
+
+        stripe->map = map_create_with_hash(value_destroy, NULL, map->seed);
+        if (stripe->map == NULL) break;
+        if (pthread_rwlock_init(&stripe->lock, NULL) != 0) {
+            map_destroy(stripe->map);
+            break;
+        }
+    }
+
+    if (map->amount < amount) {
+        concurrent_map_destroy(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+void concurrent_map_destroy(ConcurrentMap map) {
+    if (map == NULL) return;
+
+    for (size_t i = 0 ; i < map->amount ; i++) {
+        pthread_rwlock_destroy(&map->stripes[i].lock);
+        map_destroy(map->stripes[i].map);
+    }
+    free(map->stripes);
+    free(map);
+}
+
+size_t concurrent_map_size(ConcurrentMap map) {
+    if (map == NULL) return 0;
+
+    size_t size = 0;
+    for (size_t i = 0 ; i < map->amount ; i++) {
+        pthread_rwlock_rdlock(&map->stripes[i].lock);
+        size += map_size(map->stripes[i].map);
+        pthread_rwlock_unlock(&map->stripes[i].lock);
+    }
+
+    return size;
+}
+
+bool concurrent_map_put(ConcurrentMap map, char *key, void *value) {
+    if (map == NULL) return false;
+
+    stripe_t *stripe = &map->stripes[stripe_index(map, key)];
+    pthread_rwlock_wrlock(&stripe->lock);
+    bool ok = map_put(stripe->map, key, value);
+    pthread_rwlock_unlock(&stripe->lock);
+
+    return ok;
+}
+
+bool concurrent_map_contains(ConcurrentMap map, const char *key) {
+    if (map == NULL) return false;
+
+    stripe_t *stripe = &map->stripes[stripe_index(map, key)];
+    pthread_rwlock_rdlock(&stripe->lock);
+    bool contains = map_contains(stripe->map, key);
+    pthread_rwlock_unlock(&stripe->lock);
+
+    return contains;
+}
+
+void *concurrent_map_get(ConcurrentMap map, const char *key) {
+    if (map == NULL) return NULL;
+
+    stripe_t *stripe = &map->stripes[stripe_index(map, key)];
+    pthread_rwlock_rdlock(&stripe->lock);
+    void *value = map_get(stripe->map, key);
+    pthread_rwlock_unlock(&stripe->lock);
+
+    return value;
+}
+
+void *concurrent_map_remove(ConcurrentMap map, char *key) {
+    if (map == NULL) return NULL;
+
+    stripe_t *stripe = &map->stripes[stripe_index(map, key)];
+    pthread_rwlock_wrlock(&stripe->lock);
+    void *value = map_remove(stripe->map, key);
+    pthread_rwlock_unlock(&stripe->lock);
+
+    return value;
+}
+
+void concurrent_map_for_each(ConcurrentMap map, visit_func_t visit, void *extra) {
+    if (map == NULL) return;
+
+    visit_state_t state = {visit, extra, false};
+    for (size_t i = 0 ; i < map->amount && !state.stopped ; i++) {
+        pthread_rwlock_rdlock(&map->stripes[i].lock);
+        map_for_each(map->stripes[i].map, visit_until_stopped, &state);
+        pthread_rwlock_unlock(&map->stripes[i].lock);
+    }
+}
+
+void concurrent_map_for_each_parallel(ConcurrentMap map, visit_func_t visit, void *extra, size_t threads) {
+    if (map == NULL) return;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (size_t)online : 1;
+    }
+    if (threads > map->amount) threads = map->amount;
+
+    parallel_state_t state = {map, visit, extra, 0, false};
+    pthread_t *workers = (pthread_t*)malloc((threads - 1) * sizeof(pthread_t));
+    size_t started = 0;
+
+    // The calling thread is one of the workers, and it visits every stripe if no other starts
+    while (workers != NULL && started + 1 < threads && pthread_create(&workers[started], NULL, parallel_worker, &state) == 0) {
+        started++;
+    }
+    parallel_worker(&state);
+    for (size_t i = 0 ; i < started ; i++) pthread_join(workers[i], NULL);
+    free(workers);
+}
+
+/******************** Concurrent Map Builder operations definitions ********************/
+
+ConcurrentMapBuilder concurrent_map_builder_create(ConcurrentMap map) {
+    if (map == NULL) return NULL;
+
+    ConcurrentMapBuilder builder = (ConcurrentMapBuilder)malloc(sizeof(struct concurrent_map_builder_t));
+    if (builder == NULL) return NULL;
+
+    builder->pending = (pending_t*)calloc(map->amount, sizeof(pending_t));
+    if (builder->pending == NULL) {
+        free(builder);
+        return NULL;
+    }
+    builder->map = map;
+
+    return builder;
+}
+
+void concurrent_map_builder_destroy(ConcurrentMapBuilder builder) {
+    if (builder == NULL) return;
+
+    concurrent_map_builder_flush(builder);
+
+    ConcurrentMap map = builder->map;
+    for (size_t i = 0 ; i < map->amount ; i++) {
+        pending_t *pending = &builder->pending[i];
+        for (size_t j = 0 ; j < pending->count && map->value_destroy != NULL ; j++) {
+            map->value_destroy(pending->values[j]);
+        }
+        free(pending->keys);
+    }
+    free(builder->pending);
+    free(builder);
+}
+
+bool concurrent_map_builder_put(ConcurrentMapBuilder builder, char *key, void *value) {
+    if (builder == NULL) return false;
+
+    size_t index = stripe_index(builder->map, key);
+    pending_t *pending = &builder->pending[index];
+    if (pending->count == BUILDER_BATCH && !pending_flush(builder->map, index, pending)) return false;
+
+    return pending_add(pending, key, value);
+}
+
+bool concurrent_map_builder_flush(ConcurrentMapBuilder builder) {
+    if (builder == NULL) return false;
+
+    bool ok = true;
+    for (size_t i = 0 ; i < builder->map->amount ; i++) {
+        if (builder->pending[i].count > 0 && !pending_flush(builder->map, i, &builder->pending[i])) ok = false;
+    }
+
+    return ok;
+}
+
+/******************** static functions definitions ********************/
+
+/* The stripe is chosen with the high bits of the seeded hash that the Map of each stripe
+computes for the key, while that Map uses its low bits to choose a slot. So the keys of a
+stripe are still spread over its whole table, and which keys share a stripe can not be
+predicted without the seed. */
+static size_t stripe_index(ConcurrentMap map, const char *key) {
+    if (map->amount == 1) return 0;
+
+    return (size_t)(hash_finalize(hash_wy(key, strlen(key), map->seed)) >> map->shift);
+}
+
+static bool visit_until_stopped(const char *key, void *value, void *extra) {
+    visit_state_t *state = (visit_state_t*)extra;
+    if (!state->visit(key, value, state->extra)) state->stopped = true;
+
+    return !state->stopped;
+}
+
+/* Each worker takes the next stripe that nobody visited yet, so a worker that gets the
+small stripes visits more of them. */
+static void *parallel_worker(void *extra) {
+    parallel_state_t *state = (parallel_state_t*)extra;
+
+    while (!__atomic_load_n(&state->stopped, __ATOMIC_RELAXED)) {
+        size_t i = __atomic_fetch_add(&state->next, 1, __ATOMIC_RELAXED);
+        if (i >= state->map->amount) break;
+
+        pthread_rwlock_rdlock(&state->map->stripes[i].lock);
+        map_for_each(state->map->stripes[i].map, parallel_visit, state);
+        pthread_rwlock_unlock(&state->map->stripes[i].lock);
+    }
+
+    return NULL;
+}
+
+static bool parallel_visit(const char *key, void *value, void *extra) {
+    parallel_state_t *state = (parallel_state_t*)extra;
+    if (__atomic_load_n(&state->stopped, __ATOMIC_RELAXED)) return false;
+    if (!state->visit(key, value, state->extra)) {
+        __atomic_store_n(&state->stopped, true, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    return true;
+}
+
+static bool pending_add(pending_t *pending, const char *key, void *value) {
+    size_t len = strlen(key) + 1;
+
+    if (pending->keys_size + len > pending->keys_capacity) {
+        size_t capacity = pending->keys_capacity != 0 ? pending->keys_capacity : 256;
+        while (capacity < pending->keys_size + len) capacity *= 2;
+
+        char *keys = (char*)realloc(pending->keys, capacity);
+        if (keys == NULL) return false;
+        pending->keys = keys;
+        pending->keys_capacity = capacity;
+    }
+
+    memcpy(pending->keys + pending->keys_size, key, len);
+    pending->offsets[pending->count] = pending->keys_size;
+    pending->values[pending->count++] = value;
+    pending->keys_size += len;
+
+    return true;
+}
+
+/* Moves the pending pairs to the Map of their stripe, taking its lock once for all of them.
+If a pair can not be put, it and the ones after it stay pending. */
+static bool pending_flush(ConcurrentMap map, size_t index, pending_t *pending) {
+    stripe_t *stripe = &map->stripes[index];
+    size_t flushed = 0;
+
+    pthread_rwlock_wrlock(&stripe->lock);
+    while (flushed < pending->count && map_put(stripe->map, pending->keys + pending->offsets[flushed], pending->values[flushed])) {
+        flushed++;
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+
+    if (flushed == pending->count) {
+        pending->count = 0;
+        pending->keys_size = 0;
+        return true;
+    }
+
+    size_t start = pending->offsets[flushed];
+    memmove(pending->keys, pending->keys + start, pending->keys_size - start);
+    pending->keys_size -= start;
+    for (size_t i = flushed ; i < pending->count ; i++) {
+        pending->offsets[i - flushed] = pending->offsets[i] - start;
+        pending->values[i - flushed] = pending->values[i];
+    }
+    pending->count -= flushed;
+
+    return false;
+}
@@ -0,0 +1,97 @@
+#ifndef _CONCURRENT_MAP_H
+#define _CONCURRENT_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+
+/******************** Concurrent Map structures declarations ********************/
+
+/* A Map that can be used by many threads at the same time. The pairs are split into
+stripes, each one with its own Map and its own lock, so the threads only wait for each
+other when they use keys of the same stripe. */
+typedef struct concurrent_map_t *ConcurrentMap;
+/* Puts pairs into a Concurrent Map from a single thread, keeping them in a buffer of the
+thread for each stripe, so the lock of a stripe is taken once for many pairs. */
+typedef struct concurrent_map_builder_t *ConcurrentMapBuilder;
+
+/******************** Concurrent Map operations declarations ********************/
+
+/* Returns an instance of an empty Concurrent Map.
+
+PRE:
+- `value_destroy` works like the one given to `map_create`.
+- `stripes` is the amount of stripes, it is rounded up to a power of two. If 0 is given,
+a default amount is used.
+
+POST:
+- if there is not enough memory for the Concurrent Map, the function will return NULL. */
+ConcurrentMap concurrent_map_create(destroy_func_t value_destroy, size_t stripes);
+
+/* Frees the memory where the Concurrent Map is allocated. No other thread may be using
+it. */
+void concurrent_map_destroy(ConcurrentMap map);
+
+/* Returns the amount of pairs stored in the Concurrent Map. If other threads are changing
+it, the amount may already be outdated. */
+size_t concurrent_map_size(ConcurrentMap map);
+
+/* Works like `map_put`. Only the stripe of the key is locked, and any thread that uses a
+key of another stripe does not wait. */
+bool concurrent_map_put(ConcurrentMap map, char *key, void *value);
+
+/* Works like `map_contains`. Many threads can read the same stripe at the same time. */
+bool concurrent_map_contains(ConcurrentMap map, const char *key);
+
+/* Works like `map_get`. Many threads can read the same stripe at the same time.
+
+POST:
+- The returned value is not protected after the function returns, so if other threads may
+update or remove the pair, its memory must not be freed by the Concurrent Map. */
+void *concurrent_map_get(ConcurrentMap map, const char *key);
+
+/* Works like `map_remove`. */
+void *concurrent_map_remove(ConcurrentMap map, char *key);
+
+/* Works like `map_for_each`, visiting the stripes one at a time. Each stripe is locked for
+reading while its pairs are visited, so `visit` must not change the Concurrent Map. */
+void concurrent_map_for_each(ConcurrentMap map, visit_func_t visit, void *extra);
+
+/* Works like `concurrent_map_for_each`, but the stripes are split between `threads` threads,
+including the calling one, that visit them at the same time. If 0 is given, a thread is used
+for each online processor. The function returns once every pair was visited, or once a
+visit returned false.
+
+PRE:
+- `visit` can be called by many threads at the same time, so any change to `extra` must be
+synchronized. */
+void concurrent_map_for_each_parallel(ConcurrentMap map, visit_func_t visit, void *extra, size_t threads);
+
+/******************** Concurrent Map Builder operations declarations ********************/
+
+/* Returns an instance of a builder for the Concurrent Map, that must only be used by the
+thread that creates it.
+
+POST:
+- if there is not enough memory for the builder, the function will return NULL. */
+ConcurrentMapBuilder concurrent_map_builder_create(ConcurrentMap map);
+
+/* Flushes the builder and frees the memory where it is allocated. The values of the pairs
+that could not be put are destroyed. */
+void concurrent_map_builder_destroy(ConcurrentMapBuilder builder);
+
+/* Works like `concurrent_map_put`, but the pair is only seen by the other threads once the
+builder is flushed, which happens for each stripe after some pairs are put to it. If many
+builders put the same key, the value of the last flush is kept.
+
+POST:
+- Returns true if the action was successful, false if not. */
+bool concurrent_map_builder_put(ConcurrentMapBuilder builder, char *key, void *value);
+
+/* Puts every pair of the builder that is not in the Concurrent Map yet.
+
+POST:
+- Returns true if every pair was put, false if not. */
+bool concurrent_map_builder_flush(ConcurrentMapBuilder builder);
+
+#endif // _CONCURRENT_MAP_H
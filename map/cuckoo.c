@@ -0,0 +1,629 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "map.h"
+#include "map_hash.h"
+
+#define BUCKET_SLOTS 4
+#define INITIAL_BUCKETS 4
+#define VARIATION_CAPACITY 2
+// The greatest power of two of a size_t
+#define MAX_CAPACITY (SIZE_MAX / 2 + 1)
+#define MIN_CHARGE_FACTOR 0.15
+#define MAX_CHARGE_FACTOR 0.9
+#define STASH_CHARGE_FACTOR 0.5
+#define STASH_SIZE 8
+#define MAX_KICKS 256
+#define CACHE_LINE 64
+#define BUCKET_ALIGNMENT (CACHE_LINE / 2)
+#define INLINE_KEY_SIZE 16
+#define EMPTY_LEN SIZE_MAX
+#define NOT_FOUND SIZE_MAX
+
+#define VALUE_ALIGNMENT 8
+#define BATCH_SIZE 16
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/******************** structure definition ********************/
+
+/* A pair stored in the table. The keys shorter than INLINE_KEY_SIZE are stored in the slot,
+so they are compared without reading any other memory, and the longer ones are allocated on
+their own. A Map created by `map_create_sized` stores `value_size` bytes of value right after
+the slot instead of `value`. An empty slot has EMPTY_LEN as its length. */
+typedef struct slot {
+    void *value;
+    size_t len;
+    union {
+        char *stored;
+        char inlined[INLINE_KEY_SIZE];
+    } key;
+} slot_t;
+
+/* A bucket has the full hash of each of its slots, followed by the slots, so the keys are only
+compared when the hashes match and moving a pair to its other bucket does not read its key.
+Each bucket takes `bucket_size` bytes, a multiple of BUCKET_ALIGNMENT, so its hashes never
+span two cache lines: a search reads one line for each bucket, and one more for the slot whose
+hash matches. */
+typedef struct bucket {
+    uint64_t hashes[BUCKET_SLOTS];
+} bucket_t;
+
+// A pair that could not be placed in any of its buckets, with its slot (and value)
+typedef struct stash_entry {
+    uint64_t hash;
+    slot_t slot;
+} stash_entry_t;
+
+/* Every key can only be in two buckets: the first one is given by the lower bits of its
+hash, and the other one by XORing it with the higher bits, so each bucket leads to the other.
+If both are full, a pair of one of them is kicked out to its other bucket, until a free slot
+is found or MAX_KICKS pairs were moved, in which case the last kicked pair goes to the stash.
+The amount of buckets is always a power of two, and `memory` is the allocation that the
+buckets are aligned into, followed by the room for STASH_SIZE pairs of the stash. The pairs
+stashed after those go to `overflow`, which is only used when the stash fills up while the
+table is charged less than STASH_CHARGE_FACTOR, that is, when many keys share their hash. */
+typedef struct table {
+    void *memory;
+    char *buckets;
+    size_t mask;
+    char *stash;
+    size_t stash_size;
+    char *overflow;
+    size_t overflow_capacity;
+} table_t;
+
+/* Each slot takes `stride` bytes of its bucket, and each entry of the stash `entry_size`
+bytes, which include the value of a Map created by `map_create_sized`. The pairs being kicked
+by an insertion are carried in `spare`, which has room for two slots, and `removed` has room
+for a copy of the last removed value. */
+struct hash_t {
+    table_t table;
+    size_t capacity;
+    size_t size;
+    size_t value_size;
+    size_t stride;
+    size_t bucket_size;
+    size_t entry_size;
+    void *spare;
+    void *removed;
+    destroy_func_t destroy;
+    hash_func_t hash_func;
+    uint64_t seed;
+    map_stats_t stats;
+};
+
+/******************** static functions declarations ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount);
+static bool hash_table_create(Map hash, table_t *table, size_t buckets);
+static void hash_table_destroy(Map hash);
+static bool hash_table_resize(Map hash, size_t new_capacity);
+static size_t hash_place(Map hash, table_t *table, uint64_t h, const slot_t *slot);
+static bool hash_stash_reserve(Map hash, table_t *table);
+static void hash_stash_unload(Map hash, table_t *table);
+static size_t hash_other_bucket(size_t bucket, uint64_t h, size_t mask);
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h);
+static bucket_t *table_bucket(Map hash, const table_t *table, size_t bucket);
+static slot_t *bucket_slot(Map hash, bucket_t *bucket, size_t i);
+static stash_entry_t *table_stash_entry(Map hash, const table_t *table, size_t s);
+static slot_t *hash_slot(Map hash, size_t index);
+static uint64_t hash_slot_hash(Map hash, size_t index);
+static bool slot_init(Map hash, slot_t *slot, const void *key, size_t len);
+static const char *slot_key(const slot_t *slot);
+static void *slot_value(Map hash, slot_t *slot);
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found);
+static size_t hash_capacity_for(size_t amount);
+static void next_iter_index(MapIterator iter);
+
+// The operations that every implementation defines in the same way
+#include "map_common.h"
+
+/******************** Map operations definitions ********************/
+
+void map_destroy(Map hash) {
+    if (hash == NULL) return;
+
+    hash_table_destroy(hash);
+    free(hash->spare);
+    free(hash->removed);
+    free(hash);
+}
+
+bool map_reserve(Map hash, size_t amount) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(amount);
+    if (new_capacity == 0) return false;
+
+    return new_capacity <= hash->capacity || hash_table_resize(hash, new_capacity);
+}
+
+bool map_shrink_to_fit(Map hash) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(hash->size);
+
+    return new_capacity >= hash->capacity || hash_table_resize(hash, new_capacity);
+}
+
+// A missing key is searched in two buckets of one cache line each, so no filter is added
+bool map_enable_filter(Map hash) {
+    return hash != NULL;
+}
+
+void **map_entry_n(Map hash, const void *key, size_t len, bool *inserted) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.puts);
+    uint64_t h = hash_key(hash, key, len);
+    size_t index = hash_search(hash, key, len, h);
+    bool is_new = index == NOT_FOUND;
+
+    if (is_new) {
+        /* A full stash only makes the table grow if it is charged enough, so the keys that share
+        both buckets because of a bad hash function end up in the overflow instead. */
+        float charge_factor = (float)(hash->size + 1) / (float)hash->capacity;
+        bool stash_full = hash->table.stash_size >= STASH_SIZE && charge_factor > STASH_CHARGE_FACTOR;
+        if (charge_factor > MAX_CHARGE_FACTOR || stash_full) if (!hash_table_resize(hash, hash->capacity * VARIATION_CAPACITY)) return NULL;
+
+        slot_t *slot = (slot_t*)hash->spare;
+        if (!slot_init(hash, slot, key, len)) return NULL;
+        index = hash_place(hash, &hash->table, h, slot);
+        if (index == NOT_FOUND) {
+            if (len >= INLINE_KEY_SIZE) free(slot->key.stored);
+            return NULL;
+        }
+        hash->size++;
+    }
+    if (inserted != NULL) *inserted = is_new;
+
+    slot_t *slot = hash_slot(hash, index);
+
+    return hash->value_size != 0 ? (void**)slot_value(hash, slot) : &slot->value;
+}
+
+bool map_contains_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return false;
+
+    COUNT(hash->stats.gets);
+    return hash_search(hash, key, len, hash_key(hash, key, len)) != NOT_FOUND;
+}
+
+void *map_get_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.gets);
+    size_t index = hash_search(hash, key, len, hash_key(hash, key, len));
+
+    return index != NOT_FOUND ? slot_value(hash, hash_slot(hash, index)) : NULL;
+}
+
+void *map_remove_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.removes);
+    size_t index = hash_search(hash, key, len, hash_key(hash, key, len));
+    if (index == NOT_FOUND) return NULL;
+
+    slot_t *slot = hash_slot(hash, index);
+    void *deleted = slot->value;
+    if (hash->value_size != 0) deleted = memcpy(hash->removed, slot_value(hash, slot), hash->value_size);
+    if (slot->len >= INLINE_KEY_SIZE) free(slot->key.stored);
+    hash->size--;
+
+    // The last pair of the stash takes the place of the removed one, and a free slot may take others
+    size_t last = hash->table.stash_size - 1;
+    if (index < hash->capacity) {
+        slot->len = EMPTY_LEN;
+    } else if (index - hash->capacity != last) {
+        memcpy(table_stash_entry(hash, &hash->table, index - hash->capacity), table_stash_entry(hash, &hash->table, last), hash->entry_size);
+    }
+    if (index >= hash->capacity) hash->table.stash_size--;
+    hash_stash_unload(hash, &hash->table);
+
+    float charge_factor = (float)hash->size / (float)hash->capacity;
+    if (charge_factor < MIN_CHARGE_FACTOR && hash->capacity >= INITIAL_BUCKETS * BUCKET_SLOTS * VARIATION_CAPACITY) hash_table_resize(hash, hash->capacity / VARIATION_CAPACITY);
+
+    return deleted;
+}
+
+void map_for_each(Map hash, visit_func_t visit, void *extra) {
+    if (hash == NULL) return;
+
+    for (size_t i = 0 ; i < hash->capacity + hash->table.stash_size ; i++) {
+        slot_t *current = hash_slot(hash, i);
+        if (current->len != EMPTY_LEN && !visit(slot_key(current), slot_value(hash, current), extra)) break;
+    }
+}
+
+void map_stats(Map hash, map_stats_t *stats) {
+    if (hash == NULL || stats == NULL) return;
+
+    // The probe length of a pair is 0 in its first bucket, 1 in the other one and 2 in the stash
+    *stats = hash->stats;
+    stats->size = hash->size;
+    stats->capacity = hash->capacity;
+    stats->deleted = 0;
+
+    size_t total_length = 0;
+    for (size_t i = 0 ; i < hash->capacity + hash->table.stash_size ; i++) {
+        if (hash_slot(hash, i)->len == EMPTY_LEN) continue;
+
+        size_t length = 2;
+        if (i < hash->capacity) length = i / BUCKET_SLOTS == ((size_t)hash_slot_hash(hash, i) & hash->table.mask) ? 0 : 1;
+        stats_add_probe_length(stats, length);
+        total_length += length;
+    }
+    stats->average_probe_length = hash->size > 0 ? (double)total_length / (double)hash->size : 0;
+}
+
+/******************** Map Iterator operations definitions ********************/
+
+bool map_iter_has_next(const MapIterator iter) {
+    return iter != NULL && iter->current_index < iter->hash->capacity + iter->hash->table.stash_size;
+}
+
+const char *map_iter_get_current(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? slot_key(hash_slot(iter->hash, iter->current_index)) : NULL;
+}
+
+void *map_iter_get_value(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? slot_value(iter->hash, hash_slot(iter->hash, iter->current_index)) : NULL;
+}
+
+uint64_t map_iter_get_hash(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_slot_hash(iter->hash, iter->current_index) : 0;
+}
+
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n) {
+    size_t stored = 0;
+
+    for ( ; stored < n && map_iter_has_next(iter) ; stored++) {
+        slot_t *current = hash_slot(iter->hash, iter->current_index);
+        if (keys != NULL) keys[stored] = slot_key(current);
+        if (values != NULL) values[stored] = slot_value(iter->hash, current);
+
+        iter->current_index++;
+        next_iter_index(iter);
+    }
+
+    return stored;
+}
+
+/******************** static functions definitions ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount) {
+    size_t capacity = hash_capacity_for(amount);
+    if (capacity == 0) return NULL;
+
+    Map hash = (Map)malloc(sizeof(struct hash_t));
+    if (hash == NULL) return NULL;
+
+    hash->value_size = value_size;
+    hash->stride = sizeof(slot_t) + (value_size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+    hash->bucket_size = (sizeof(bucket_t) + BUCKET_SLOTS * hash->stride + BUCKET_ALIGNMENT - 1) / BUCKET_ALIGNMENT * BUCKET_ALIGNMENT;
+    hash->entry_size = offsetof(stash_entry_t, slot) + hash->stride;
+    hash->spare = malloc(2 * hash->stride);
+    hash->removed = value_size != 0 ? malloc(value_size) : NULL;
+    if (hash->spare == NULL || (value_size != 0 && hash->removed == NULL) || !hash_table_create(hash, &hash->table, capacity / BUCKET_SLOTS)) {
+        free(hash->spare);
+        free(hash->removed);
+        free(hash);
+        return NULL;
+    }
+
+    hash->capacity = capacity;
+    hash->size = 0;
+    hash->destroy = value_destroy;
+    hash->hash_func = hash_func != NULL ? hash_func : hash_wy;
+    hash->seed = seed;
+    memset(&hash->stats, 0, sizeof(map_stats_t));
+
+    return hash;
+}
+
+/* The buckets are aligned to the cache lines by hand, as C99 has no aligned allocation, and
+every byte of their slots is set to 0xFF, so each slot has EMPTY_LEN as its length. */
+static bool hash_table_create(Map hash, table_t *table, size_t buckets) {
+    size_t stash_bytes = STASH_SIZE * hash->entry_size;
+    if (buckets > (SIZE_MAX - CACHE_LINE - stash_bytes) / hash->bucket_size) return false;
+
+    size_t bytes = buckets * hash->bucket_size;
+    table->memory = malloc(bytes + stash_bytes + CACHE_LINE);
+    if (table->memory == NULL) return false;
+
+    uintptr_t address = (uintptr_t)table->memory;
+    table->buckets = (char*)(address + (CACHE_LINE - address % CACHE_LINE) % CACHE_LINE);
+    memset(table->buckets, 0xFF, bytes);
+    table->mask = buckets - 1;
+    table->stash = table->buckets + bytes;
+    table->stash_size = 0;
+    table->overflow = NULL;
+    table->overflow_capacity = 0;
+
+    return true;
+}
+
+static void hash_table_destroy(Map hash) {
+    for (size_t i = 0 ; i < hash->capacity + hash->table.stash_size ; i++) {
+        slot_t *current = hash_slot(hash, i);
+        if (current->len == EMPTY_LEN) continue;
+        if (hash->destroy != NULL) (hash->destroy)(slot_value(hash, current));
+        if (current->len >= INLINE_KEY_SIZE) free(current->key.stored);
+    }
+
+    free(hash->table.memory);
+    free(hash->table.overflow);
+}
+
+/* The slots are copied to a new table with the stored hashes, so neither the keys nor the
+values are read, and the keys that are allocated on their own do not move. Placing a slot only
+fails if the overflow of the stash can not grow. */
+static bool hash_table_resize(Map hash, size_t new_capacity) {
+    clock_t start = clock();
+    table_t new_table;
+    if (!hash_table_create(hash, &new_table, new_capacity / BUCKET_SLOTS)) return false;
+
+    for (size_t i = 0 ; i < hash->capacity + hash->table.stash_size ; i++) {
+        slot_t *current = hash_slot(hash, i);
+        if (current->len == EMPTY_LEN || hash_place(hash, &new_table, hash_slot_hash(hash, i), current) != NOT_FOUND) continue;
+
+        free(new_table.memory);
+        free(new_table.overflow);
+        return false;
+    }
+
+    free(hash->table.memory);
+    free(hash->table.overflow);
+    hash->table = new_table;
+    hash->capacity = new_capacity;
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return true;
+}
+
+/* Puts a copy of a slot whose key is not stored in the table into a free slot of one of its
+buckets. If both are full, a pair of the current bucket is kicked out to its other bucket, and
+the slot kicked in each bucket changes with each kick so the same pairs are not moved back and
+forth. After MAX_KICKS kicks, the pair that is left goes to the stash, which has room for it
+before any pair is moved, so the table does not change if there is not enough memory. The
+kicked pairs are carried in the slots of `spare`, and the given pair is followed while it is
+kicked: returns the index where it is stored, or NOT_FOUND if there is not enough memory. */
+static size_t hash_place(Map hash, table_t *table, uint64_t h, const slot_t *slot) {
+    if (!hash_stash_reserve(hash, table)) return NOT_FOUND;
+
+    slot_t *carried = (slot_t*)hash->spare;
+    slot_t *kicked = (slot_t*)((char*)hash->spare + hash->stride);
+    memmove(carried, slot, hash->stride);
+    size_t bucket = (size_t)h & table->mask;
+    // The index of the given pair once it is kicked into a slot, NOT_FOUND while it is carried
+    size_t placed = NOT_FOUND;
+
+    for (size_t kicks = 0 ; kicks < MAX_KICKS ; kicks++) {
+        size_t candidates[2] = {bucket, hash_other_bucket(bucket, h, table->mask)};
+
+        for (size_t b = 0 ; b < 2 ; b++) {
+            bucket_t *current = table_bucket(hash, table, candidates[b]);
+            for (size_t i = 0 ; i < BUCKET_SLOTS ; i++) {
+                slot_t *free_slot = bucket_slot(hash, current, i);
+                if (free_slot->len != EMPTY_LEN) continue;
+                current->hashes[i] = h;
+                memcpy(free_slot, carried, hash->stride);
+                return placed != NOT_FOUND ? placed : candidates[b] * BUCKET_SLOTS + i;
+            }
+        }
+
+        // Every pair is kicked out to the bucket it was not in
+        bucket_t *current = table_bucket(hash, table, candidates[1]);
+        size_t victim = (kicks + (size_t)(h >> 62)) % BUCKET_SLOTS;
+        size_t victim_index = candidates[1] * BUCKET_SLOTS + victim;
+        slot_t *victim_slot = bucket_slot(hash, current, victim);
+        uint64_t kicked_hash = current->hashes[victim];
+        memcpy(kicked, victim_slot, hash->stride);
+        memcpy(victim_slot, carried, hash->stride);
+        current->hashes[victim] = h;
+
+        if (placed == NOT_FOUND) placed = victim_index;
+        else if (placed == victim_index) placed = NOT_FOUND;
+
+        slot_t *swap = carried;
+        carried = kicked;
+        kicked = swap;
+        h = kicked_hash;
+        bucket = candidates[1];
+    }
+
+    size_t s = table->stash_size++;
+    stash_entry_t *entry = table_stash_entry(hash, table, s);
+    entry->hash = h;
+    memcpy(&entry->slot, carried, hash->stride);
+
+    return placed != NOT_FOUND ? placed : (table->mask + 1) * BUCKET_SLOTS + s;
+}
+
+// Makes room for one more pair in the stash, which only allocates memory for the overflow
+static bool hash_stash_reserve(Map hash, table_t *table) {
+    if (table->stash_size < STASH_SIZE + table->overflow_capacity) return true;
+
+    size_t new_capacity = table->overflow_capacity > 0 ? table->overflow_capacity * VARIATION_CAPACITY : STASH_SIZE;
+    char *overflow = (char*)realloc(table->overflow, new_capacity * hash->entry_size);
+    if (overflow == NULL) return false;
+    table->overflow = overflow;
+    table->overflow_capacity = new_capacity;
+
+    return true;
+}
+
+// Moves the pairs of the stash that have a free slot in one of their buckets into it
+static void hash_stash_unload(Map hash, table_t *table) {
+    for (size_t s = 0 ; s < table->stash_size ; ) {
+        stash_entry_t *entry = table_stash_entry(hash, table, s);
+        size_t candidates[2] = {(size_t)entry->hash & table->mask, hash_other_bucket((size_t)entry->hash & table->mask, entry->hash, table->mask)};
+        bool placed = false;
+
+        for (size_t b = 0 ; b < 2 && !placed ; b++) {
+            bucket_t *current = table_bucket(hash, table, candidates[b]);
+            for (size_t i = 0 ; i < BUCKET_SLOTS && !placed ; i++) {
+                slot_t *free_slot = bucket_slot(hash, current, i);
+                if (free_slot->len != EMPTY_LEN) continue;
+                current->hashes[i] = entry->hash;
+                memcpy(free_slot, &entry->slot, hash->stride);
+                placed = true;
+            }
+        }
+
+        if (!placed) {
+            s++;
+            continue;
+        }
+        size_t last = --table->stash_size;
+        if (s != last) memcpy(entry, table_stash_entry(hash, table, last), hash->entry_size);
+    }
+}
+
+/* Returns the other bucket of a key with the given hash. The mask is never 0, so the XORed
+bits are never 0 either and the two buckets of a key are always different. */
+static size_t hash_other_bucket(size_t bucket, uint64_t h, size_t mask) {
+    return bucket ^ (((size_t)(h >> 32) | 1) & mask);
+}
+
+/* Returns the index of the slot (or the stash entry) that stores the key, or NOT_FOUND. Only
+the two buckets of the key are read, and the second one is prefetched while the first is
+checked; the stash is only searched if it has any pair. */
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h) {
+    table_t *table = &hash->table;
+    size_t first = (size_t)h & table->mask;
+    size_t candidates[2] = {first, hash_other_bucket(first, h, table->mask)};
+    PREFETCH(table_bucket(hash, table, candidates[1]));
+
+    for (size_t b = 0 ; b < 2 ; b++) {
+        bucket_t *current = table_bucket(hash, table, candidates[b]);
+        COUNT(hash->stats.probes);
+
+        for (size_t i = 0 ; i < BUCKET_SLOTS ; i++) {
+            if (current->hashes[i] != h) continue;
+            slot_t *slot = bucket_slot(hash, current, i);
+            if (slot->len == len && memcmp(slot_key(slot), key, len) == 0) return candidates[b] * BUCKET_SLOTS + i;
+        }
+    }
+
+    for (size_t s = 0 ; s < table->stash_size ; s++) {
+        stash_entry_t *entry = table_stash_entry(hash, table, s);
+        COUNT(hash->stats.probes);
+        if (entry->hash == h && entry->slot.len == len && memcmp(slot_key(&entry->slot), key, len) == 0) return hash->capacity + s;
+    }
+
+    return NOT_FOUND;
+}
+
+static bucket_t *table_bucket(Map hash, const table_t *table, size_t bucket) {
+    return (bucket_t*)(table->buckets + bucket * hash->bucket_size);
+}
+
+static slot_t *bucket_slot(Map hash, bucket_t *bucket, size_t i) {
+    return (slot_t*)((char*)(bucket + 1) + i * hash->stride);
+}
+
+// The first STASH_SIZE entries of the stash are after the buckets, and the rest in the overflow
+static stash_entry_t *table_stash_entry(Map hash, const table_t *table, size_t s) {
+    if (s < STASH_SIZE) return (stash_entry_t*)(table->stash + s * hash->entry_size);
+
+    return (stash_entry_t*)(table->overflow + (s - STASH_SIZE) * hash->entry_size);
+}
+
+/* Returns the given slot or the slot of the given stash entry: the indexes from 0 to
+`capacity` are for the slots of the buckets, and the ones after that are for the stash. */
+static slot_t *hash_slot(Map hash, size_t index) {
+    if (index >= hash->capacity) return &table_stash_entry(hash, &hash->table, index - hash->capacity)->slot;
+
+    return bucket_slot(hash, table_bucket(hash, &hash->table, index / BUCKET_SLOTS), index % BUCKET_SLOTS);
+}
+
+static uint64_t hash_slot_hash(Map hash, size_t index) {
+    if (index >= hash->capacity) return table_stash_entry(hash, &hash->table, index - hash->capacity)->hash;
+
+    return table_bucket(hash, &hash->table, index / BUCKET_SLOTS)->hashes[index % BUCKET_SLOTS];
+}
+
+/* Sets up the slot with a copy of the key followed by a '\0', and a NULL value (or a value
+with all its bytes set to zero). Returns false if there is not enough memory for the copy. */
+static bool slot_init(Map hash, slot_t *slot, const void *key, size_t len) {
+    char *copy = len < INLINE_KEY_SIZE ? slot->key.inlined : (char*)malloc(len + 1);
+    if (copy == NULL) return false;
+
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    if (len >= INLINE_KEY_SIZE) slot->key.stored = copy;
+    slot->len = len;
+    slot->value = NULL;
+    if (hash->value_size != 0) memset(slot + 1, 0, hash->value_size);
+
+    return true;
+}
+
+static const char *slot_key(const slot_t *slot) {
+    return slot->len < INLINE_KEY_SIZE ? slot->key.inlined : slot->key.stored;
+}
+
+// Returns the value of the slot, or the address of its bytes if the Map stores them
+static void *slot_value(Map hash, slot_t *slot) {
+    return hash->value_size != 0 ? (void*)(slot + 1) : slot->value;
+}
+
+/* Searches the keys in batches of BATCH_SIZE: first every key of the batch is hashed and the
+memory of both of its buckets is prefetched, and then they are searched. Either `values` or
+`found` can be NULL. */
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found) {
+    if (hash == NULL) return 0;
+
+    uint64_t hashes[BATCH_SIZE];
+    size_t lens[BATCH_SIZE];
+    size_t stored = 0;
+
+    for (size_t start = 0 ; start < n ; start += BATCH_SIZE) {
+        size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            lens[i] = strlen(keys[start + i]);
+            hashes[i] = hash_key(hash, keys[start + i], lens[i]);
+            size_t first = (size_t)hashes[i] & hash->table.mask;
+            PREFETCH(table_bucket(hash, &hash->table, first));
+            PREFETCH(table_bucket(hash, &hash->table, hash_other_bucket(first, hashes[i], hash->table.mask)));
+        }
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            size_t index = hash_search(hash, keys[start + i], lens[i], hashes[i]);
+            COUNT(hash->stats.gets);
+            bool is_stored = index != NOT_FOUND;
+            void *value = is_stored ? slot_value(hash, hash_slot(hash, index)) : NULL;
+            if (values != NULL) values[start + i] = value;
+            if (found != NULL) found[start + i] = is_stored;
+            if (is_stored) stored++;
+        }
+    }
+
+    return stored;
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t hash_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_BUCKETS * BUCKET_SLOTS;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
+static void next_iter_index(MapIterator iter) {
+    while (map_iter_has_next(iter) && hash_slot(iter->hash, iter->current_index)->len == EMPTY_LEN) iter->current_index++;
+}
@@ -0,0 +1,515 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "frozen_map.h"
+#include "map_hash.h"
+
+#define BUCKET_SIZE 3
+#define EXTRA_POSITIONS 50
+#define INLINE_KEY_SIZE 16
+#define STORED_KEY_MARK 1
+#define MAX_ATTEMPTS 16
+
+#define FILE_MAGIC "FROZMAP1"
+#define FILE_BYTE_ORDER 0x0102030405060708ULL
+#define FILE_ALIGNMENT 8
+#define NO_VALUE UINT64_MAX
+
+/******************** structure definition ********************/
+
+/* The keys shorter than INLINE_KEY_SIZE are stored in the slot, so a lookup only reads the
+slot. The longer ones are stored in the block of keys of the Frozen Map, and the slot has the
+offset of their first byte and STORED_KEY_MARK as its last byte, where an inlined key always
+has a '\0'. The value is a pointer, or its offset in the block of values if the Frozen Map
+was opened from a file. */
+typedef struct frozen_slot {
+    uint64_t hash;
+    union {
+        void *pointer;
+        uint64_t offset;
+    } value;
+    union {
+        size_t stored;
+        char inlined[INLINE_KEY_SIZE];
+    } key;
+} frozen_slot_t;
+
+/* The pairs are split into buckets by their hash, and each bucket has a pilot: the number
+mixed with the hash of its keys to get their positions. The pilots are chosen when the map
+is frozen so that no two keys get the same position. There are a few more positions than
+slots, so a pilot is found after a few tries even for the last buckets, and each position
+past the last slot is remapped to one of the slots left free.
+
+Every field but the pointers is position independent, so a Frozen Map opened from a file
+points into the mapped file, where `mapping` starts. */
+struct frozen_map_t {
+    frozen_slot_t *slots;
+    uint16_t *pilots;
+    size_t *remap;
+    char *keys;
+    char *values;
+    size_t size;
+    size_t positions;
+    size_t buckets;
+    size_t keys_size;
+    uint64_t seed;
+    void *mapping;
+    size_t mapping_size;
+};
+
+/* The file starts with this header, followed by the pilots, the remap, the keys, the values
+and the slots, each one starting at a multiple of FILE_ALIGNMENT. The byte order and the size
+of a word must be the ones of the machine that opens the file. */
+typedef struct file_header {
+    char magic[8];
+    uint64_t byte_order;
+    uint64_t word_size;
+    uint64_t size;
+    uint64_t positions;
+    uint64_t buckets;
+    uint64_t keys_size;
+    uint64_t values_size;
+    uint64_t seed;
+} file_header_t;
+
+// The pairs of the Map, while it is frozen
+typedef struct frozen_pair {
+    const char *key;
+    size_t len;
+    void *value;
+} frozen_pair_t;
+
+typedef struct collect_state {
+    frozen_pair_t *pairs;
+    size_t amount;
+} collect_state_t;
+
+/******************** static functions declarations ********************/
+
+static bool collect_pair(const char *key, void *value, void *extra);
+static bool frozen_place(FrozenMap map, const uint64_t *hashes, size_t *positions);
+static bool frozen_place_bucket(FrozenMap map, const uint64_t *hashes, const size_t *keys, size_t amount, bool *taken, size_t *positions, size_t bucket);
+static void frozen_remap(FrozenMap map, const bool *taken, size_t *positions);
+static size_t frozen_bucket(uint64_t h, size_t buckets);
+static size_t frozen_position(uint64_t h, uint16_t pilot, size_t positions);
+static frozen_slot_t *frozen_search(FrozenMap map, const char *key);
+static const char *slot_key(FrozenMap map, const frozen_slot_t *slot);
+static void *slot_value(FrozenMap map, const frozen_slot_t *slot);
+static bool file_write(FrozenMap map, FILE *file, serialize_func_t serialize);
+static bool file_write_padded(FILE *file, const void *bytes, size_t size, uint64_t *written);
+static bool file_layout(const file_header_t *header, size_t file_size, size_t offsets[5]);
+static bool file_check(FrozenMap map, size_t values_size);
+static size_t file_align(size_t size);
+static size_t hash_reduce(uint64_t h, size_t range);
+
+/******************** Frozen Map operations definitions ********************/
+
+FrozenMap map_freeze(Map map) {
+    if (map == NULL) return NULL;
+
+    FrozenMap frozen = (FrozenMap)calloc(1, sizeof(struct frozen_map_t));
+    if (frozen == NULL) return NULL;
+
+    size_t size = map_size(map);
+    frozen->size = size;
+    frozen->positions = size + size / EXTRA_POSITIONS + 1;
+    frozen->buckets = size / BUCKET_SIZE + 1;
+
+    collect_state_t state = {(frozen_pair_t*)malloc((size + 1) * sizeof(frozen_pair_t)), 0};
+    uint64_t *hashes = (uint64_t*)malloc((size + 1) * sizeof(uint64_t));
+    size_t *positions = (size_t*)malloc((size + 1) * sizeof(size_t));
+    frozen->slots = (frozen_slot_t*)malloc((size + 1) * sizeof(frozen_slot_t));
+    frozen->pilots = (uint16_t*)malloc(frozen->buckets * sizeof(uint16_t));
+    frozen->remap = (size_t*)malloc((frozen->positions - size) * sizeof(size_t));
+
+    bool ok = state.pairs != NULL && hashes != NULL && positions != NULL && frozen->slots != NULL && frozen->pilots != NULL && frozen->remap != NULL;
+    if (ok) map_for_each(map, collect_pair, &state);
+
+    size_t keys_size = 0;
+    for (size_t i = 0 ; ok && i < size ; i++) if (state.pairs[i].len >= INLINE_KEY_SIZE) keys_size += state.pairs[i].len + 1;
+    frozen->keys_size = keys_size;
+    if (ok) frozen->keys = (char*)malloc(keys_size + 1);
+    ok = ok && frozen->keys != NULL;
+
+    // A new seed is tried if a bucket can not be placed with any pilot, which is very unlikely
+    bool placed = false;
+    for (int attempt = 0 ; ok && !placed && attempt < MAX_ATTEMPTS ; attempt++) {
+        frozen->seed = hash_random_seed();
+        for (size_t i = 0 ; i < size ; i++) hashes[i] = hash_wy(state.pairs[i].key, state.pairs[i].len, frozen->seed);
+        placed = frozen_place(frozen, hashes, positions);
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0 ; placed && i < size ; i++) {
+        frozen_slot_t *slot = &frozen->slots[positions[i]];
+        slot->hash = hashes[i];
+        slot->value.pointer = state.pairs[i].value;
+        memset(slot->key.inlined, 0, INLINE_KEY_SIZE);
+
+        if (state.pairs[i].len < INLINE_KEY_SIZE) {
+            memcpy(slot->key.inlined, state.pairs[i].key, state.pairs[i].len);
+            continue;
+        }
+        slot->key.stored = offset;
+        slot->key.inlined[INLINE_KEY_SIZE - 1] = STORED_KEY_MARK;
+        memcpy(frozen->keys + offset, state.pairs[i].key, state.pairs[i].len + 1);
+        offset += state.pairs[i].len + 1;
+    }
+
+    free(state.pairs);
+    free(hashes);
+    free(positions);
+
+    if (!placed) {
+        frozen_map_destroy(frozen);
+        return NULL;
+    }
+
+    return frozen;
+}
+
+FrozenMap map_open_mmap(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat status;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(file_header_t)) {
+        mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) return NULL;
+
+    const file_header_t *header = (const file_header_t*)mapping;
+    size_t offsets[5];
+    FrozenMap map = NULL;
+    if (file_layout(header, (size_t)status.st_size, offsets)) map = (FrozenMap)malloc(sizeof(struct frozen_map_t));
+    if (map == NULL) {
+        munmap(mapping, (size_t)status.st_size);
+        return NULL;
+    }
+
+    char *bytes = (char*)mapping;
+    map->pilots = (uint16_t*)(bytes + offsets[0]);
+    map->remap = (size_t*)(bytes + offsets[1]);
+    map->keys = bytes + offsets[2];
+    map->values = bytes + offsets[3];
+    map->slots = (frozen_slot_t*)(bytes + offsets[4]);
+    map->size = (size_t)header->size;
+    map->positions = (size_t)header->positions;
+    map->buckets = (size_t)header->buckets;
+    map->keys_size = (size_t)header->keys_size;
+    map->seed = header->seed;
+    map->mapping = mapping;
+    map->mapping_size = (size_t)status.st_size;
+
+    if (!file_check(map, (size_t)header->values_size)) {
+        frozen_map_destroy(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+bool map_save(Map map, const char *path, serialize_func_t serialize) {
+    FrozenMap frozen = map_freeze(map);
+    if (frozen == NULL) return false;
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file != NULL && file_write(frozen, file, serialize);
+    if (file != NULL && fclose(file) != 0) ok = false;
+    frozen_map_destroy(frozen);
+
+    return ok;
+}
+
+void frozen_map_destroy(FrozenMap map) {
+    if (map == NULL) return;
+
+    if (map->mapping != NULL) {
+        munmap(map->mapping, map->mapping_size);
+        free(map);
+        return;
+    }
+
+    free(map->slots);
+    free(map->pilots);
+    free(map->remap);
+    free(map->keys);
+    free(map);
+}
+
+size_t frozen_map_size(FrozenMap map) {
+    return map != NULL ? map->size : 0;
+}
+
+bool frozen_map_contains(FrozenMap map, const char *key) {
+    return frozen_search(map, key) != NULL;
+}
+
+void *frozen_map_get(FrozenMap map, const char *key) {
+    frozen_slot_t *slot = frozen_search(map, key);
+
+    return slot != NULL ? slot_value(map, slot) : NULL;
+}
+
+void frozen_map_for_each(FrozenMap map, visit_func_t visit, void *extra) {
+    if (map == NULL) return;
+
+    for (size_t i = 0 ; i < map->size ; i++) {
+        if (!visit(slot_key(map, &map->slots[i]), slot_value(map, &map->slots[i]), extra)) break;
+    }
+}
+
+/******************** static functions definitions ********************/
+
+static bool collect_pair(const char *key, void *value, void *extra) {
+    collect_state_t *state = (collect_state_t*)extra;
+    frozen_pair_t *pair = &state->pairs[state->amount++];
+
+    pair->key = key;
+    pair->len = strlen(key);
+    pair->value = value;
+
+    return true;
+}
+
+/* Chooses the pilot of every bucket, starting with the biggest buckets, while most of the
+slots are still free. The slot of each key is stored in `positions`. */
+static bool frozen_place(FrozenMap map, const uint64_t *hashes, size_t *positions) {
+    size_t buckets = map->buckets;
+    size_t *starts = (size_t*)calloc(buckets + 1, sizeof(size_t));
+    size_t *keys = (size_t*)malloc((map->size + 1) * sizeof(size_t));
+    size_t *order = (size_t*)malloc(buckets * sizeof(size_t));
+    bool *taken = (bool*)calloc(map->positions, sizeof(bool));
+    bool ok = starts != NULL && keys != NULL && order != NULL && taken != NULL;
+
+    if (ok) {
+        // The keys are sorted by bucket: the keys of bucket `b` are keys[starts[b]..starts[b+1]]
+        size_t largest = 0;
+        for (size_t i = 0 ; i < map->size ; i++) starts[frozen_bucket(hashes[i], buckets) + 1]++;
+        for (size_t b = 0 ; b < buckets ; b++) {
+            if (starts[b + 1] > largest) largest = starts[b + 1];
+            starts[b + 1] += starts[b];
+        }
+        for (size_t i = 0 ; i < map->size ; i++) keys[--starts[frozen_bucket(hashes[i], buckets) + 1]] = i;
+        memmove(starts, starts + 1, buckets * sizeof(size_t));
+        starts[buckets] = map->size;
+
+        size_t amount = 0;
+        for (size_t size = largest ; size > 0 ; size--) {
+            for (size_t b = 0 ; b < buckets ; b++) if (starts[b + 1] - starts[b] == size) order[amount++] = b;
+        }
+        for (size_t b = 0 ; b < buckets ; b++) map->pilots[b] = 0;
+
+        for (size_t i = 0 ; ok && i < amount ; i++) {
+            size_t b = order[i];
+            ok = frozen_place_bucket(map, hashes, keys + starts[b], starts[b + 1] - starts[b], taken, positions, b);
+        }
+        if (ok) frozen_remap(map, taken, positions);
+    }
+
+    free(starts);
+    free(keys);
+    free(order);
+    free(taken);
+
+    return ok;
+}
+
+// Tries each pilot until every key of the bucket gets a different free slot
+static bool frozen_place_bucket(FrozenMap map, const uint64_t *hashes, const size_t *keys, size_t amount, bool *taken, size_t *positions, size_t bucket) {
+    for (size_t i = 0 ; i < amount ; i++) {
+        for (size_t j = 0 ; j < i ; j++) if (hashes[keys[i]] == hashes[keys[j]]) return false;
+    }
+
+    for (uint32_t pilot = 0 ; pilot <= UINT16_MAX ; pilot++) {
+        size_t placed = 0;
+
+        for ( ; placed < amount ; placed++) {
+            size_t position = frozen_position(hashes[keys[placed]], (uint16_t)pilot, map->positions);
+            if (taken[position]) break;
+
+            taken[position] = true;
+            positions[keys[placed]] = position;
+        }
+
+        if (placed == amount) {
+            map->pilots[bucket] = (uint16_t)pilot;
+            return true;
+        }
+        for (size_t i = 0 ; i < placed ; i++) taken[positions[keys[i]]] = false;
+    }
+
+    return false;
+}
+
+/* Gives each taken position past the last slot one of the free slots, in order. The positions
+that no key took are remapped to the first slot, where a missing key is not found either. */
+static void frozen_remap(FrozenMap map, const bool *taken, size_t *positions) {
+    size_t free_slot = 0;
+
+    for (size_t position = map->size ; position < map->positions ; position++) {
+        map->remap[position - map->size] = 0;
+        if (!taken[position]) continue;
+
+        while (taken[free_slot]) free_slot++;
+        map->remap[position - map->size] = free_slot++;
+    }
+
+    for (size_t i = 0 ; i < map->size ; i++) {
+        if (positions[i] >= map->size) positions[i] = map->remap[positions[i] - map->size];
+    }
+}
+
+static size_t frozen_bucket(uint64_t h, size_t buckets) {
+    return hash_reduce(h, buckets);
+}
+
+/* The pilot is spread over every bit before it is mixed with the hash, so the keys of a
+bucket, which share the high bits of their hash, get unrelated slots. */
+static size_t frozen_position(uint64_t h, uint16_t pilot, size_t positions) {
+    uint64_t x = h ^ (pilot * HASH_P0);
+
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+
+    return hash_reduce(x, positions);
+}
+
+static frozen_slot_t *frozen_search(FrozenMap map, const char *key) {
+    if (map == NULL || map->size == 0) return NULL;
+
+    uint64_t h = hash_wy(key, strlen(key), map->seed);
+    size_t position = frozen_position(h, map->pilots[frozen_bucket(h, map->buckets)], map->positions);
+    if (position >= map->size) position = map->remap[position - map->size];
+    frozen_slot_t *slot = &map->slots[position];
+
+    return slot->hash == h && strcmp(slot_key(map, slot), key) == 0 ? slot : NULL;
+}
+
+static const char *slot_key(FrozenMap map, const frozen_slot_t *slot) {
+    return slot->key.inlined[INLINE_KEY_SIZE - 1] == STORED_KEY_MARK ? map->keys + slot->key.stored : slot->key.inlined;
+}
+
+static void *slot_value(FrozenMap map, const frozen_slot_t *slot) {
+    if (map->mapping == NULL) return slot->value.pointer;
+
+    return slot->value.offset != NO_VALUE ? map->values + slot->value.offset : NULL;
+}
+
+/* Writes the values before the slots, so the offset of each value is known when its slot is
+written, and writes the header again at the end with the size of the values. */
+static bool file_write(FrozenMap map, FILE *file, serialize_func_t serialize) {
+    file_header_t header = {FILE_MAGIC, FILE_BYTE_ORDER, sizeof(size_t), map->size, map->positions, map->buckets, map->keys_size, 0, map->seed};
+    uint64_t written = 0;
+
+    bool ok = file_write_padded(file, &header, sizeof(header), &written);
+    ok = ok && file_write_padded(file, map->pilots, map->buckets * sizeof(uint16_t), &written);
+    ok = ok && file_write_padded(file, map->remap, (map->positions - map->size) * sizeof(size_t), &written);
+    ok = ok && file_write_padded(file, map->keys, map->keys_size, &written);
+
+    uint64_t *offsets = (uint64_t*)malloc((map->size + 1) * sizeof(uint64_t));
+    ok = ok && offsets != NULL;
+
+    uint64_t values_start = written;
+    for (size_t i = 0 ; ok && i < map->size ; i++) {
+        size_t len = 0;
+        const void *bytes = serialize != NULL ? serialize(map->slots[i].value.pointer, &len) : NULL;
+
+        offsets[i] = bytes != NULL ? written - values_start : NO_VALUE;
+        if (bytes != NULL) ok = file_write_padded(file, bytes, len, &written);
+    }
+    header.values_size = written - values_start;
+
+    for (size_t i = 0 ; ok && i < map->size ; i++) {
+        frozen_slot_t slot = map->slots[i];
+        slot.value.offset = offsets[i];
+        ok = fwrite(&slot, sizeof(slot), 1, file) == 1;
+    }
+    free(offsets);
+
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    return ok;
+}
+
+static bool file_write_padded(FILE *file, const void *bytes, size_t size, uint64_t *written) {
+    static const char padding[FILE_ALIGNMENT] = {0};
+    size_t padded = file_align(size);
+
+    if (size > 0 && fwrite(bytes, 1, size, file) != size) return false;
+    if (padded > size && fwrite(padding, 1, padded - size, file) != padded - size) return false;
+    *written += padded;
+
+    return true;
+}
+
+/* Checks the header and computes where each block of the file starts. Every amount is checked
+against the size of the file before it is multiplied, so nothing overflows. */
+static bool file_layout(const file_header_t *header, size_t file_size, size_t offsets[5]) {
+    if (memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->byte_order != FILE_BYTE_ORDER || header->word_size != sizeof(size_t)) return false;
+    if (header->positions <= header->size || header->buckets == 0) return false;
+    if (header->positions > file_size || header->buckets > file_size || header->keys_size > file_size || header->values_size > file_size) return false;
+
+    size_t offset = sizeof(file_header_t);
+    offsets[0] = offset;
+    offset += file_align((size_t)header->buckets * sizeof(uint16_t));
+    offsets[1] = offset;
+    offset += file_align((size_t)(header->positions - header->size) * sizeof(size_t));
+    offsets[2] = offset;
+    offset += file_align((size_t)header->keys_size);
+    offsets[3] = offset;
+    offset += (size_t)header->values_size;
+    offsets[4] = offset;
+    offset += (size_t)header->size * sizeof(frozen_slot_t);
+
+    return offset == file_size;
+}
+
+/* Checks every offset read from the file, so a damaged or crafted file is not opened instead
+of making a lookup read outside of it: each remapped position is a slot, each stored key
+ends with a '\0' inside the block of keys, and each value starts inside the block of values. */
+static bool file_check(FrozenMap map, size_t values_size) {
+    // An empty Frozen Map is never searched, so its remap is not read
+    for (size_t i = 0 ; map->size > 0 && i < map->positions - map->size ; i++) {
+        if (map->remap[i] >= map->size) return false;
+    }
+
+    for (size_t i = 0 ; i < map->size ; i++) {
+        const frozen_slot_t *slot = &map->slots[i];
+        char mark = slot->key.inlined[INLINE_KEY_SIZE - 1];
+
+        if (mark != STORED_KEY_MARK && mark != '\0') return false;
+        if (mark == STORED_KEY_MARK && slot->key.stored >= map->keys_size) return false;
+        if (mark == STORED_KEY_MARK && memchr(map->keys + slot->key.stored, '\0', map->keys_size - slot->key.stored) == NULL) return false;
+        if (slot->value.offset != NO_VALUE && slot->value.offset >= values_size) return false;
+    }
+
+    return true;
+}
+
+static size_t file_align(size_t size) {
+    return (size + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT * FILE_ALIGNMENT;
+}
+
+// Maps the hash to [0, range) with the high bits of a multiplication, instead of a division
+static size_t hash_reduce(uint64_t h, size_t range) {
+#ifdef __SIZEOF_INT128__
+    __extension__ unsigned __int128 product = (unsigned __int128)h * range;
+
+    return (size_t)(product >> 64);
+#else
+    return (size_t)(h % range);
+#endif
+}
+
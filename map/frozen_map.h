@@ -0,0 +1,74 @@
+#ifndef _FROZEN_MAP_H
+#define _FROZEN_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+
+/******************** Frozen Map structures declarations ********************/
+
+/* A read-only copy of a Map. Its pairs are placed with a minimal perfect hash, so there is
+exactly one slot for each pair and a lookup reads a single slot, and its keys are stored
+one after the other in a single block of memory. */
+typedef struct frozen_map_t *FrozenMap;
+/* Returns the bytes that represent the value in a file, and stores their amount in `len`. If
+NULL is returned, the value is not saved. */
+typedef const void *(*serialize_func_t)(void *value, size_t *len);
+
+/******************** Frozen Map operations declarations ********************/
+
+/* Returns a Frozen Map with the pairs stored in the Map. The keys are copied, and the Map
+can be changed or destroyed afterwards, but the values are shared: the Frozen Map does not
+destroy them, so if the Map is destroyed before it, the Map must not destroy them either.
+
+PRE:
+- The keys of the Map are strings; the bytes of a key after a '\0' are not copied.
+
+POST:
+- if there is not enough memory for the Frozen Map, the function will return NULL. */
+FrozenMap map_freeze(Map map);
+
+/* Saves the pairs stored in the Map to a file, as a Frozen Map that `map_open_mmap` can open
+without reading each pair. The bytes of each value are given by `serialize`, or no value is
+saved if it is NULL.
+
+PRE:
+- The keys of the Map are strings, like for `map_freeze`.
+
+POST:
+- Returns true if the file was written, false if not. */
+bool map_save(Map map, const char *path, serialize_func_t serialize);
+
+/* Returns the Frozen Map saved to the file by `map_save`. The file is mapped into memory and
+only read: opening it checks each slot once, without copying any pair, and every process that
+opens it shares its pages.
+
+PRE:
+- The file was saved by `map_save` on a machine with the same byte order and word size, and
+it is not changed while it is open.
+
+POST:
+- The values are the bytes given by the serializer, which must not be changed. They are
+aligned to 8 bytes.
+- if the file can not be opened, or it is not a Frozen Map, the function will return NULL.
+- if an offset of the file points outside of it, as in a damaged or crafted file, the
+function will return NULL. */
+FrozenMap map_open_mmap(const char *path);
+
+/* Frees the memory where the Frozen Map is allocated, or unmaps its file. The values are not
+destroyed. */
+void frozen_map_destroy(FrozenMap map);
+
+/* Returns the amount of pairs stored in the Frozen Map. */
+size_t frozen_map_size(FrozenMap map);
+
+/* Returns true if the key is stored in the Frozen Map, false if not. */
+bool frozen_map_contains(FrozenMap map, const char *key);
+
+/* Returns the value of the given key, or NULL if it is not stored in the Frozen Map. */
+void *frozen_map_get(FrozenMap map, const char *key);
+
+/* Works like `map_for_each`, visiting the pairs in the order of their slots. */
+void frozen_map_for_each(FrozenMap map, visit_func_t visit, void *extra);
+
+#endif // _FROZEN_MAP_H
@@ -1,123 +1,224 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include "map.h"
+#include "map_hash.h"
+#include "map_filter.h"
 
-#define INITIAL_CAPACITY 19
+#define INITIAL_CAPACITY 16
 #define VARIATION_CAPACITY 2
+// The greatest power of two of a size_t
+#define MAX_CAPACITY (SIZE_MAX / 2 + 1)
 #define MIN_CHARGE_FACTOR 0.15
 #define MAX_CHARGE_FACTOR 0.65
+#define INLINE_KEY_SIZE 16
+#define ARENA_CHUNK_SIZE 4096
+#define ARENA_MAX_CHUNK_SIZE (1 << 20)
+
+#define VALUE_ALIGNMENT 8
+#define BATCH_SIZE 16
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
 
 /******************** structure definition ********************/ 
 
+// A slot is only MISPLACED while the table is purged, until its pair is placed again
 typedef enum {
     EMPTY = 0,
     TAKEN,
-    DELETED
+    DELETED,
+    MISPLACED
 } state_t;
 
+/* The hash of the key is stored with the pair, so the keys are only compared when the
+hashes match and the table can be resized without hashing the keys again. The keys shorter
+than INLINE_KEY_SIZE are stored inside the pair, and the longer ones in the arena of the Map. */
 typedef struct pair {
-    char *key;
+    union {
+        char *stored;
+        char inlined[INLINE_KEY_SIZE];
+    } key;
     void *value;
+    uint64_t hash;
+    uint32_t len;
     state_t state;
 } pair_t;
 
+/* The long keys are copied one after the other into chunks of memory that are only freed all
+together. The bytes of the removed keys (`dead`) are not reused until the arena is compacted
+while the table is resized. */
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t used;
+    size_t capacity;
+    char bytes[];
+} arena_chunk_t;
+
+typedef struct arena {
+    arena_chunk_t *chunks;
+    size_t live;
+    size_t dead;
+} arena_t;
+
+/* The capacity is always a power of two, so the index of a hash is `hash & (capacity-1)`.
+Each pair takes `stride` bytes of the table: a Map created by `map_create_sized` stores
+`value_size` bytes of value right after each pair, and `removed` has room for a copy of the
+last removed value. */
 struct hash_t {
     pair_t *table;
     size_t capacity;
     size_t size;
     size_t deleted;
+    size_t value_size;
+    size_t stride;
+    void *removed;
+    arena_t keys;
+    filter_t filter;
     destroy_func_t destroy;
-};
-
-struct hash_iter_t {
-    Map hash;
-    size_t current_index;
+    hash_func_t hash_func;
+    uint64_t seed;
+    map_stats_t stats;
 };
 
 /******************** static functions declarations ********************/ 
 
-static pair_t *hash_table_create(size_t capacity);
-static void hash_table_destroy(pair_t *table, size_t capacity, destroy_func_t value_destroy);
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount);
+static pair_t *hash_table_create(Map hash, size_t capacity);
+static void hash_table_destroy(Map hash);
 static bool hash_table_resize(Map hash, size_t new_capacity);
-static size_t hash_search(Map hash, const char *key);
-static uint64_t hash_expected_index(Map hash, const char *key);
-static uint64_t hash_fnv(const uint8_t *bytes);
+static bool hash_table_purge(Map hash);
+static pair_t *hash_pair(Map hash, pair_t *table, size_t index);
+static void *pair_value(Map hash, pair_t *pair);
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h);
+static size_t hash_expected_index(uint64_t h, size_t capacity);
+static bool hash_store_key(Map hash, pair_t *pair, const void *key, size_t len);
+static void hash_release_key(Map hash, pair_t *pair);
+static const char *pair_key(const pair_t *pair);
+static char *arena_alloc(arena_t *arena, size_t size);
+static void arena_compact(Map hash);
+static void arena_destroy(arena_t *arena);
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found);
+static size_t hash_capacity_for(size_t amount);
 static void next_iter_index(MapIterator iter);
-static char *strdup(const char *src);
+
+// The operations that every implementation defines in the same way
+#include "map_common.h"
 
 /******************** Map operations definitions ********************/
 
-Map map_create(destroy_func_t value_destroy) {
-    Map hash = (Map)malloc(sizeof(struct hash_t));
-    if (hash == NULL) return NULL;
+void map_destroy(Map hash) {
+    if (hash == NULL) return;
 
-    hash->table = hash_table_create(INITIAL_CAPACITY);
-    if (hash->table == NULL) {
-        free(hash);
-        return NULL;
-    }
+    hash_table_destroy(hash);
+    arena_destroy(&hash->keys);
+    free(hash->filter.memory);
+    free(hash->removed);
+    free(hash);
+}
 
-    hash->capacity = INITIAL_CAPACITY;
-    hash->size = 0;
-    hash->deleted = 0;
-    hash->destroy = value_destroy;
+bool map_reserve(Map hash, size_t amount) {
+    if (hash == NULL) return false;
 
-    return hash;
+    size_t new_capacity = hash_capacity_for(amount);
+    if (new_capacity == 0) return false;
+
+    return new_capacity <= hash->capacity || hash_table_resize(hash, new_capacity);
 }
 
-void map_destroy(Map hash) {
-    if (hash == NULL) return;
+bool map_shrink_to_fit(Map hash) {
+    if (hash == NULL) return false;
 
-    hash_table_destroy(hash->table, hash->capacity, hash->destroy);
-    free(hash);
-}
+    size_t new_capacity = hash_capacity_for(hash->size);
 
-size_t map_size(Map hash) {
-    return hash != NULL ? hash->size : 0;
+    return new_capacity >= hash->capacity || hash_table_resize(hash, new_capacity);
 }
 
-bool map_put(Map hash, char *key, void *value) {
+bool map_enable_filter(Map hash) {
     if (hash == NULL) return false;
+    if (hash->filter.memory != NULL) return true;
+
+    if (!filter_create(&hash->filter, hash->capacity)) return false;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->state == TAKEN) filter_update(&hash->filter, current->hash, true);
+    }
+
+    return true;
+}
+
+void **map_entry_n(Map hash, const void *key, size_t len, bool *inserted) {
+    if (hash == NULL) return NULL;
 
+    COUNT(hash->stats.puts);
     float charge_factor = (float)(hash->size + hash->deleted) / (float)hash->capacity;
-    if (charge_factor > MAX_CHARGE_FACTOR) if (!hash_table_resize(hash, hash->capacity * VARIATION_CAPACITY)) return false;
+    if (charge_factor > MAX_CHARGE_FACTOR) {
+        // When most of the load are deleted slots, the table is rebuilt in place with the same capacity
+        bool purged = (float)(hash->size + 1) / (float)hash->capacity <= MAX_CHARGE_FACTOR / VARIATION_CAPACITY && hash_table_purge(hash);
+        if (!purged && !hash_table_resize(hash, hash->capacity * VARIATION_CAPACITY)) return NULL;
+    }
 
-    size_t index = hash_search(hash, key);
+    uint64_t h = hash_key(hash, key, len);
+    pair_t *pair = hash_pair(hash, hash->table, hash_search(hash, key, len, h));
+    bool is_new = pair->state == EMPTY;
 
-    if (hash->table[index].state == EMPTY) {
-        hash->table[index].key = strdup(key);
-        if (hash->table[index].key == NULL) return false;
+    if (is_new) {
+        if (!hash_store_key(hash, pair, key, len)) return NULL;
         hash->size++;
-        hash->table[index].state = TAKEN;
-    } else if (hash->table[index].state == TAKEN && hash->destroy != NULL) (hash->destroy)(hash->table[index].value);
-    hash->table[index].value = value;
+        pair->hash = h;
+        pair->state = TAKEN;
+        pair->value = NULL;
+        if (hash->filter.memory != NULL) filter_update(&hash->filter, h, true);
+        if (hash->value_size != 0) memset(pair_value(hash, pair), 0, hash->value_size);
+    }
+    if (inserted != NULL) *inserted = is_new;
 
-    return true;
+    return hash->value_size != 0 ? (void**)pair_value(hash, pair) : &pair->value;
 }
 
-bool map_contains(Map hash, const char *key) {
-    return hash != NULL && hash->table[hash_search(hash, key)].state == TAKEN;
+bool map_contains_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return false;
+
+    COUNT(hash->stats.gets);
+    uint64_t h = hash_key(hash, key, len);
+    if (!filter_contains(&hash->filter, h)) return false;
+
+    return hash_pair(hash, hash->table, hash_search(hash, key, len, h))->state == TAKEN;
 }
 
-void *map_get(Map hash, const char *key) {
+void *map_get_n(Map hash, const void *key, size_t len) {
     if (hash == NULL) return NULL;
-    
-    size_t index = hash_search(hash, key);
 
-    return hash->table[index].state == TAKEN ? hash->table[index].value : NULL;
+    COUNT(hash->stats.gets);
+    uint64_t h = hash_key(hash, key, len);
+    if (!filter_contains(&hash->filter, h)) return NULL;
+
+    pair_t *pair = hash_pair(hash, hash->table, hash_search(hash, key, len, h));
+
+    return pair->state == TAKEN ? pair_value(hash, pair) : NULL;
 }
 
-void *map_remove(Map hash, char *key) {
+void *map_remove_n(Map hash, const void *key, size_t len) {
     if (hash == NULL) return NULL;
 
-    size_t index = hash_search(hash, key);
-    if (hash->table[index].state != TAKEN) return NULL;
+    COUNT(hash->stats.removes);
+    uint64_t h = hash_key(hash, key, len);
+    if (!filter_contains(&hash->filter, h)) return NULL;
+
+    pair_t *pair = hash_pair(hash, hash->table, hash_search(hash, key, len, h));
+    if (pair->state != TAKEN) return NULL;
+    if (hash->filter.memory != NULL) filter_update(&hash->filter, h, false);
 
     hash->size--;
     hash->deleted++;
-    hash->table[index].state = DELETED;
-    void *deleted = hash->table[index].value;
+    pair->state = DELETED;
+    hash_release_key(hash, pair);
+    void *deleted = pair->value;
+    if (hash->value_size != 0) deleted = memcpy(hash->removed, pair_value(hash, pair), hash->value_size);
     
     float charge_factor = (float)hash->size / (float)hash->capacity;
     if (charge_factor < MIN_CHARGE_FACTOR && hash->capacity >= INITIAL_CAPACITY * VARIATION_CAPACITY) if (!hash_table_resize(hash, hash->capacity / VARIATION_CAPACITY)) return NULL;
@@ -128,139 +229,376 @@ void *map_remove(Map hash, char *key) {
 void map_for_each(Map hash, visit_func_t visit, void *extra) {
     if (hash == NULL) return;
     
-    pair_t current;
+    pair_t *current;
     for (size_t i = 0 ; i < hash->capacity ; i++) {
-        current = hash->table[i];
-        if (current.state == TAKEN && !visit(current.key, current.value, extra)) break;
+        current = hash_pair(hash, hash->table, i);
+        if (current->state == TAKEN && !visit(pair_key(current), pair_value(hash, current), extra)) break;
     }
 }
 
-/******************** Map Iterator operations definitions ********************/
-
-MapIterator map_iter_create(Map hash) {
-    if (hash == NULL) return NULL;
+void map_stats(Map hash, map_stats_t *stats) {
+    if (hash == NULL || stats == NULL) return;
 
-    MapIterator iter = (MapIterator)malloc(sizeof(struct hash_iter_t));
-    if (iter == NULL) return NULL;
+    *stats = hash->stats;
+    stats->size = hash->size;
+    stats->capacity = hash->capacity;
+    stats->deleted = hash->deleted;
 
-    iter->hash = hash;
-    iter->current_index = 0;
-    next_iter_index(iter);
+    size_t total_length = 0;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->state != TAKEN) continue;
 
-    return iter;
+        size_t length = (i - hash_expected_index(current->hash, hash->capacity)) & (hash->capacity-1);
+        stats_add_probe_length(stats, length);
+        total_length += length;
+    }
+    stats->average_probe_length = hash->size > 0 ? (double)total_length / (double)hash->size : 0;
 }
 
-void map_iter_destroy(MapIterator iter) {
-    free(iter);
-}
+/******************** Map Iterator operations definitions ********************/
 
 bool map_iter_has_next(const MapIterator iter) {
     return iter != NULL && iter->current_index < iter->hash->capacity;
 }
 
-bool map_iter_next(MapIterator iter) {
-    if (iter == NULL || !map_iter_has_next(iter)) return false;
+const char *map_iter_get_current(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? pair_key(hash_pair(iter->hash, iter->hash->table, iter->current_index)) : NULL;
+}
 
-    iter->current_index++;
-    next_iter_index(iter);
+void *map_iter_get_value(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? pair_value(iter->hash, hash_pair(iter->hash, iter->hash->table, iter->current_index)) : NULL;
+}
 
-    return true;
+uint64_t map_iter_get_hash(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_pair(iter->hash, iter->hash->table, iter->current_index)->hash : 0;
 }
 
-const char *map_iter_get_current(const MapIterator iter) {
-    return iter != NULL && map_iter_has_next(iter) ? iter->hash->table[iter->current_index].key : NULL;
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n) {
+    size_t stored = 0;
+
+    for ( ; stored < n && map_iter_has_next(iter) ; stored++) {
+        pair_t *current = hash_pair(iter->hash, iter->hash->table, iter->current_index);
+        if (keys != NULL) keys[stored] = pair_key(current);
+        if (values != NULL) values[stored] = pair_value(iter->hash, current);
+
+        iter->current_index++;
+        next_iter_index(iter);
+    }
+
+    return stored;
 }
 
 /******************** static functions definitions ********************/
 
-static pair_t *hash_table_create(size_t capacity) {
-    pair_t *table = (pair_t*)malloc(capacity * sizeof(pair_t));
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount) {
+    size_t capacity = hash_capacity_for(amount);
+    if (capacity == 0) return NULL;
+
+    Map hash = (Map)malloc(sizeof(struct hash_t));
+    if (hash == NULL) return NULL;
+
+    hash->value_size = value_size;
+    hash->stride = sizeof(pair_t) + (value_size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+    hash->removed = NULL;
+    hash->table = hash_table_create(hash, capacity);
+    if (value_size != 0) hash->removed = malloc(value_size);
+    if (hash->table == NULL || (value_size != 0 && hash->removed == NULL)) {
+        free(hash->table);
+        free(hash->removed);
+        free(hash);
+        return NULL;
+    }
+
+    hash->capacity = capacity;
+    hash->size = 0;
+    hash->deleted = 0;
+    hash->keys.chunks = NULL;
+    hash->keys.live = 0;
+    hash->keys.dead = 0;
+    hash->filter.memory = NULL;
+    hash->filter.blocks = NULL;
+    hash->destroy = value_destroy;
+    hash->hash_func = hash_func != NULL ? hash_func : hash_wy;
+    hash->seed = seed;
+    memset(&hash->stats, 0, sizeof(map_stats_t));
+
+    return hash;
+}
+
+static pair_t *hash_table_create(Map hash, size_t capacity) {
+    if (capacity > SIZE_MAX / hash->stride) return NULL;
+
+    pair_t *table = (pair_t*)malloc(capacity * hash->stride);
     if (table == NULL) return NULL;
 
     for (size_t i = 0 ; i < capacity ; i++) {
-        table[i].state = EMPTY;
-        table[i].key = NULL;
-        table[i].value = NULL;
+        pair_t *pair = hash_pair(hash, table, i);
+        pair->state = EMPTY;
+        pair->value = NULL;
+        pair->hash = 0;
+        pair->len = 0;
     }
 
     return table;
 }
 
-static void hash_table_destroy(pair_t *table, size_t capacity, destroy_func_t value_destroy) {
-    pair_t current;
-
-    for (size_t i = 0 ; i < capacity ; i++) {
-        current = table[i];
-        if (current.state != EMPTY) free(current.key); 
-        if (current.state == TAKEN && value_destroy != NULL) (value_destroy)(current.value);
+static void hash_table_destroy(Map hash) {
+    for (size_t i = 0 ; hash->destroy != NULL && i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->state == TAKEN) (hash->destroy)(pair_value(hash, current));
     }
 
-    free(table);
+    free(hash->table);
 }
 
 static bool hash_table_resize(Map hash, size_t new_capacity) {
-    pair_t *old_table = hash->table;
-    hash->table = hash_table_create(new_capacity);
-    if (hash->table == NULL) {
-        hash->table = old_table;
+    clock_t start = clock();
+    pair_t *new_table = hash_table_create(hash, new_capacity);
+    if (new_table == NULL) return false;
+
+    // The filter is rebuilt for the new capacity, which also clears its saturated counters
+    filter_t new_filter = {NULL, NULL, 0};
+    if (hash->filter.memory != NULL && !filter_create(&new_filter, new_capacity)) {
+        free(new_table);
         return false;
     }
 
-    size_t old_capacity = hash->capacity;
+    // The pairs are moved with their stored hash, the keys are neither copied nor hashed again
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->state != TAKEN) continue;
+
+        size_t index = hash_expected_index(current->hash, new_capacity);
+        while (hash_pair(hash, new_table, index)->state != EMPTY) index = (index+1) & (new_capacity-1);
+        memcpy(hash_pair(hash, new_table, index), current, hash->stride);
+        if (new_filter.memory != NULL) filter_update(&new_filter, current->hash, true);
+    }
+    free(hash->table);
+    free(hash->filter.memory);
+    hash->filter = new_filter;
+
+    hash->table = new_table;
     hash->capacity = new_capacity;
-    hash->size = 0;
     hash->deleted = 0;
 
-    for (size_t i = 0 ; i < old_capacity ; i++) {
-        if (old_table[i].state == TAKEN) {
-            bool ok = map_put(hash, old_table[i].key, old_table[i].value);
-            if (!ok) return false;
-            old_table[i].state = DELETED;
+    if (hash->keys.dead > hash->keys.live) arena_compact(hash);
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return true;
+}
+
+/* Removes the deleted slots without allocating another table: every pair is marked as
+misplaced and then placed again at the first slot of its probe sequence that is not taken. If
+that slot has a misplaced pair, they are swapped and the misplaced one is placed next, so each
+pair is moved about once. The searches never go through a misplaced slot, so emptying it
+before placing its pair keeps every placed pair reachable. */
+static bool hash_table_purge(Map hash) {
+    clock_t start = clock();
+    pair_t *carried = (pair_t*)malloc(2 * hash->stride);
+    if (carried == NULL) return false;
+    pair_t *swap = hash_pair(hash, carried, 1);
+
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        current->state = current->state == TAKEN ? MISPLACED : EMPTY;
+    }
+
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->state != MISPLACED) continue;
+
+        memcpy(carried, current, hash->stride);
+        current->state = EMPTY;
+
+        for (bool placing = true ; placing ; ) {
+            size_t index = hash_expected_index(carried->hash, hash->capacity);
+            while (hash_pair(hash, hash->table, index)->state == TAKEN) index = (index+1) & (hash->capacity-1);
+
+            pair_t *slot = hash_pair(hash, hash->table, index);
+            placing = slot->state == MISPLACED;
+            if (placing) memcpy(swap, slot, hash->stride);
+            memcpy(slot, carried, hash->stride);
+            slot->state = TAKEN;
+            if (placing) memcpy(carried, swap, hash->stride);
         }
     }
-    hash_table_destroy(old_table, old_capacity, hash->destroy);
+    free(carried);
+    hash->deleted = 0;
+
+    if (hash->keys.dead > hash->keys.live) arena_compact(hash);
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
 
     return true;
 }
 
-static size_t hash_search(Map hash, const char *key) {
-    size_t index = hash_expected_index(hash, key);
-    pair_t current;
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h) {
+    size_t index = hash_expected_index(h, hash->capacity);
+    pair_t *current;
 
-    for ( ; hash->table[index].state != EMPTY ; index = (index+1) % hash->capacity) {
-        current = hash->table[index];
-        if (current.state == TAKEN && strcmp(current.key, key) == 0) return index;
+    for ( ; hash_pair(hash, hash->table, index)->state != EMPTY ; index = (index+1) & (hash->capacity-1)) {
+        current = hash_pair(hash, hash->table, index);
+        COUNT(hash->stats.probes);
+        if (current->state == TAKEN && current->hash == h && current->len == len && memcmp(pair_key(current), key, len) == 0) return index;
     }
 
     return index;
 }
 
-static uint64_t hash_expected_index(Map hash, const char *key) {
-    const uint8_t *key_bytes = (const uint8_t*)key;
-    uint64_t index = hash_fnv(key_bytes);
+static pair_t *hash_pair(Map hash, pair_t *table, size_t index) {
+    return (pair_t*)((char*)table + index * hash->stride);
+}
+
+// Returns the value of the pair, or the address of its bytes if the Map stores them
+static void *pair_value(Map hash, pair_t *pair) {
+    return hash->value_size != 0 ? (void*)(pair + 1) : pair->value;
+}
 
-    return index % hash->capacity;
+static size_t hash_expected_index(uint64_t h, size_t capacity) {
+    return (size_t)h & (capacity-1);
 }
 
-static uint64_t hash_fnv(const uint8_t *bytes) {
-    uint64_t h = 2166136261UL;
+// Copies the key followed by a '\0' into the pair if it is short enough, or into the arena
+static bool hash_store_key(Map hash, pair_t *pair, const void *key, size_t len) {
+    if ((uint32_t)len != len) return false;
 
-    for (int i = 0 ; bytes[i] != '\0' ; i++) {
-        h ^= bytes[i];
-        h *= 16777619;
+    char *copy = pair->key.inlined;
+    if (len >= INLINE_KEY_SIZE) {
+        copy = arena_alloc(&hash->keys, len + 1);
+        if (copy == NULL) return false;
+        pair->key.stored = copy;
     }
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    pair->len = (uint32_t)len;
 
-    return h;
+    return true;
 }
 
-static void next_iter_index(MapIterator iter) {
-    while (map_iter_has_next(iter) && iter->hash->table[iter->current_index].state != TAKEN) iter->current_index++;
+static void hash_release_key(Map hash, pair_t *pair) {
+    if (pair->len < INLINE_KEY_SIZE) return;
+
+    hash->keys.live -= pair->len + 1;
+    hash->keys.dead += pair->len + 1;
 }
 
-static char *strdup(const char *src) {
-    char *string = (char*)malloc((strlen(src)+1) * sizeof(char));
-    if (string == NULL) return NULL;
-    strcpy(string, src);
+static const char *pair_key(const pair_t *pair) {
+    return pair->len < INLINE_KEY_SIZE ? pair->key.inlined : pair->key.stored;
+}
+
+static char *arena_alloc(arena_t *arena, size_t size) {
+    arena_chunk_t *chunk = arena->chunks;
+
+    if (chunk == NULL || chunk->capacity - chunk->used < size) {
+        size_t capacity = chunk == NULL ? ARENA_CHUNK_SIZE : chunk->capacity * 2;
+        if (capacity < ARENA_CHUNK_SIZE) capacity = ARENA_CHUNK_SIZE;
+        if (capacity > ARENA_MAX_CHUNK_SIZE) capacity = ARENA_MAX_CHUNK_SIZE;
+        if (capacity < size) capacity = size;
+
+        chunk = (arena_chunk_t*)malloc(sizeof(arena_chunk_t) + capacity);
+        if (chunk == NULL) return NULL;
+        chunk->next = arena->chunks;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        arena->chunks = chunk;
+    }
 
-    return string;
+    char *bytes = chunk->bytes + chunk->used;
+    chunk->used += size;
+    arena->live += size;
+
+    return bytes;
+}
+
+/* Copies the long keys of the table into a single chunk with no space for removed keys, and
+frees the previous chunks. If there is not enough memory, the arena is kept as it is. */
+static void arena_compact(Map hash) {
+    arena_t compacted = {NULL, 0, 0};
+
+    if (hash->keys.live > 0) {
+        compacted.chunks = (arena_chunk_t*)malloc(sizeof(arena_chunk_t) + hash->keys.live);
+        if (compacted.chunks == NULL) return;
+        compacted.chunks->next = NULL;
+        compacted.chunks->used = 0;
+        compacted.chunks->capacity = hash->keys.live;
+    }
+
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->state != TAKEN || current->len < INLINE_KEY_SIZE) continue;
+
+        char *copy = arena_alloc(&compacted, current->len + 1);
+        memcpy(copy, current->key.stored, current->len + 1);
+        current->key.stored = copy;
+    }
+
+    arena_destroy(&hash->keys);
+    hash->keys = compacted;
+}
+
+static void arena_destroy(arena_t *arena) {
+    arena_chunk_t *chunk = arena->chunks;
+
+    while (chunk != NULL) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
+
+/* Searches the keys in batches of BATCH_SIZE: first every key of the batch is hashed and the
+memory of its expected slot is prefetched, and then they are searched. Either `values` or
+`found` can be NULL. */
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found) {
+    if (hash == NULL) return 0;
+
+    uint64_t hashes[BATCH_SIZE];
+    size_t lens[BATCH_SIZE];
+    size_t stored = 0;
+
+    for (size_t start = 0 ; start < n ; start += BATCH_SIZE) {
+        size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            lens[i] = strlen(keys[start + i]);
+            hashes[i] = hash_key(hash, keys[start + i], lens[i]);
+            PREFETCH(hash_pair(hash, hash->table, hash_expected_index(hashes[i], hash->capacity)));
+        }
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            COUNT(hash->stats.gets);
+            bool is_stored = false;
+            pair_t *pair = NULL;
+            if (filter_contains(&hash->filter, hashes[i])) {
+                pair = hash_pair(hash, hash->table, hash_search(hash, keys[start + i], lens[i], hashes[i]));
+                is_stored = pair->state == TAKEN;
+            }
+            void *value = is_stored ? pair_value(hash, pair) : NULL;
+            if (values != NULL) values[start + i] = value;
+            if (found != NULL) found[start + i] = is_stored;
+            if (is_stored) stored++;
+        }
+    }
+
+    return stored;
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t hash_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_CAPACITY;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
+static void next_iter_index(MapIterator iter) {
+    while (map_iter_has_next(iter) && hash_pair(iter->hash, iter->hash->table, iter->current_index)->state != TAKEN) iter->current_index++;
 }
\ No newline at end of file
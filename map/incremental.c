@@ -0,0 +1,510 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "map.h"
+#include "map_hash.h"
+
+#define INITIAL_CAPACITY 16
+#define VARIATION_CAPACITY 2
+// The greatest power of two of a size_t
+#define MAX_CAPACITY (SIZE_MAX / 2 + 1)
+#define MIN_CHARGE_FACTOR 0.15
+#define MAX_CHARGE_FACTOR 0.65
+#define MIGRATION_STEP 32
+#define NOT_FOUND SIZE_MAX
+
+#define VALUE_ALIGNMENT 8
+#define BATCH_SIZE 16
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/******************** structure definition ********************/
+
+typedef enum {
+    EMPTY = 0,
+    TAKEN,
+    DELETED
+} state_t;
+
+typedef struct pair {
+    char *key;
+    void *value;
+    uint64_t hash;
+    size_t len;
+    state_t state;
+} pair_t;
+
+/* While the Map is being resized, the pairs are moved from `old_table` to `table` a few
+slots at a time, starting from `migrated`. A key is stored in only one of the two tables,
+`old_size` is the amount of pairs that are still in `old_table` and `size` counts the pairs
+of both tables. The resize time of the stats only counts the start of each migration and the
+migrations finished at once, not the steps spread over the other operations. The capacities
+are always powers of two. Each pair takes `stride` bytes of a table: a Map created by
+`map_create_sized` stores `value_size` bytes of value right after each pair, and `removed`
+has room for a copy of the last removed value. */
+struct hash_t {
+    pair_t *table;
+    size_t capacity;
+    size_t size;
+    size_t deleted;
+    pair_t *old_table;
+    size_t old_capacity;
+    size_t old_size;
+    size_t migrated;
+    size_t value_size;
+    size_t stride;
+    void *removed;
+    destroy_func_t destroy;
+    hash_func_t hash_func;
+    uint64_t seed;
+    map_stats_t stats;
+};
+
+/******************** static functions declarations ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount);
+static pair_t *hash_table_create(Map hash, size_t capacity);
+static void hash_table_destroy(Map hash, pair_t *table, size_t capacity);
+static bool hash_migration_start(Map hash, size_t new_capacity);
+static void hash_migration_step(Map hash, size_t slots);
+static pair_t *hash_pair(Map hash, pair_t *table, size_t index);
+static void *pair_value(Map hash, pair_t *pair);
+static pair_t *hash_find(Map hash, const void *key, size_t len, uint64_t h);
+static size_t hash_search(Map hash, pair_t *table, size_t capacity, const void *key, size_t len, uint64_t h);
+static size_t hash_free_index(Map hash, pair_t *table, size_t capacity, uint64_t h);
+static void hash_table_stats(Map hash, pair_t *table, size_t capacity, size_t from, map_stats_t *stats);
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found);
+static size_t hash_capacity_for(size_t amount);
+static pair_t *iter_pair(const MapIterator iter);
+static void next_iter_index(MapIterator iter);
+static char *key_copy(const void *key, size_t len);
+
+// The operations that every implementation defines in the same way
+#include "map_common.h"
+
+/******************** Map operations definitions ********************/
+
+void map_destroy(Map hash) {
+    if (hash == NULL) return;
+
+    hash_table_destroy(hash, hash->table, hash->capacity);
+    if (hash->old_table != NULL) hash_table_destroy(hash, hash->old_table, hash->old_capacity);
+    free(hash->removed);
+    free(hash);
+}
+
+/* The new table is allocated right away, but the pairs are still migrated a few at a time
+by the following operations. */
+bool map_reserve(Map hash, size_t amount) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(amount);
+    if (new_capacity == 0) return false;
+    if (new_capacity <= hash->capacity) return true;
+
+    hash_migration_step(hash, hash->old_capacity);
+
+    return hash_migration_start(hash, new_capacity);
+}
+
+bool map_shrink_to_fit(Map hash) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(hash->size);
+    if (new_capacity >= hash->capacity) return true;
+
+    hash_migration_step(hash, hash->old_capacity);
+
+    return hash_migration_start(hash, new_capacity);
+}
+
+/* A filter would have to be rebuilt from every pair at the start of each migration, which
+is the pause this Map avoids, so no filter is added. */
+bool map_enable_filter(Map hash) {
+    return hash != NULL;
+}
+
+void **map_entry_n(Map hash, const void *key, size_t len, bool *inserted) {
+    if (hash == NULL) return NULL;
+
+    hash_migration_step(hash, MIGRATION_STEP);
+
+    COUNT(hash->stats.puts);
+    uint64_t h = hash_key(hash, key, len);
+    pair_t *pair = hash_find(hash, key, len, h);
+
+    if (pair != NULL) {
+        if (inserted != NULL) *inserted = false;
+        return hash->value_size != 0 ? (void**)pair_value(hash, pair) : &pair->value;
+    }
+
+    float charge_factor = (float)(hash->size - hash->old_size + hash->deleted) / (float)hash->capacity;
+    if (charge_factor > MAX_CHARGE_FACTOR) {
+        // It only happens if the table fills up before the previous resize finished
+        hash_migration_step(hash, hash->old_capacity);
+        // When most of the load are deleted slots, the pairs are migrated to a table of the same capacity
+        size_t new_capacity = (float)(hash->size + 1) / (float)hash->capacity > MAX_CHARGE_FACTOR / VARIATION_CAPACITY ? hash->capacity * VARIATION_CAPACITY : hash->capacity;
+        if (!hash_migration_start(hash, new_capacity)) return NULL;
+    }
+
+    pair = hash_pair(hash, hash->table, hash_free_index(hash, hash->table, hash->capacity, h));
+    pair->key = key_copy(key, len);
+    if (pair->key == NULL) return NULL;
+    pair->value = NULL;
+    pair->hash = h;
+    pair->len = len;
+    pair->state = TAKEN;
+    hash->size++;
+    if (inserted != NULL) *inserted = true;
+
+    if (hash->value_size == 0) return &pair->value;
+    memset(pair_value(hash, pair), 0, hash->value_size);
+
+    return (void**)pair_value(hash, pair);
+}
+
+bool map_contains_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return false;
+
+    COUNT(hash->stats.gets);
+    return hash_find(hash, key, len, hash_key(hash, key, len)) != NULL;
+}
+
+void *map_get_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.gets);
+    pair_t *pair = hash_find(hash, key, len, hash_key(hash, key, len));
+
+    return pair != NULL ? pair_value(hash, pair) : NULL;
+}
+
+void *map_remove_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    hash_migration_step(hash, MIGRATION_STEP);
+
+    COUNT(hash->stats.removes);
+    uint64_t h = hash_key(hash, key, len);
+    pair_t *pair = NULL;
+    size_t index = hash_search(hash, hash->table, hash->capacity, key, len, h);
+
+    // Both tables keep a deleted mark, so the probe sequences that go through the pair stay valid
+    if (index != NOT_FOUND) {
+        pair = hash_pair(hash, hash->table, index);
+        hash->deleted++;
+    } else if (hash->old_table != NULL && (index = hash_search(hash, hash->old_table, hash->old_capacity, key, len, h)) != NOT_FOUND) {
+        pair = hash_pair(hash, hash->old_table, index);
+        hash->old_size--;
+    } else {
+        return NULL;
+    }
+    hash->size--;
+    pair->state = DELETED;
+    free(pair->key);
+    pair->key = NULL;
+    void *deleted = pair->value;
+    if (hash->value_size != 0) deleted = memcpy(hash->removed, pair_value(hash, pair), hash->value_size);
+
+    float charge_factor = (float)hash->size / (float)hash->capacity;
+    if (charge_factor < MIN_CHARGE_FACTOR && hash->old_table == NULL && hash->capacity >= INITIAL_CAPACITY * VARIATION_CAPACITY) hash_migration_start(hash, hash->capacity / VARIATION_CAPACITY);
+
+    return deleted;
+}
+
+void map_for_each(Map hash, visit_func_t visit, void *extra) {
+    if (hash == NULL) return;
+
+    pair_t *current;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        current = hash_pair(hash, hash->table, i);
+        if (current->state == TAKEN && !visit(current->key, pair_value(hash, current), extra)) return;
+    }
+
+    for (size_t i = hash->migrated ; hash->old_table != NULL && i < hash->old_capacity ; i++) {
+        current = hash_pair(hash, hash->old_table, i);
+        if (current->state == TAKEN && !visit(current->key, pair_value(hash, current), extra)) return;
+    }
+}
+
+void map_stats(Map hash, map_stats_t *stats) {
+    if (hash == NULL || stats == NULL) return;
+
+    *stats = hash->stats;
+    stats->size = hash->size;
+    stats->capacity = hash->capacity;
+    stats->deleted = hash->deleted;
+
+    // The pairs that were not migrated yet have the probe length of the old table
+    hash_table_stats(hash, hash->table, hash->capacity, 0, stats);
+    if (hash->old_table != NULL) hash_table_stats(hash, hash->old_table, hash->old_capacity, hash->migrated, stats);
+    stats->average_probe_length = hash->size > 0 ? stats->average_probe_length / (double)hash->size : 0;
+}
+
+/******************** Map Iterator operations definitions ********************/
+
+bool map_iter_has_next(const MapIterator iter) {
+    return iter != NULL && iter->current_index < iter->hash->capacity + iter->hash->old_capacity;
+}
+
+const char *map_iter_get_current(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? iter_pair(iter)->key : NULL;
+}
+
+void *map_iter_get_value(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? pair_value(iter->hash, iter_pair(iter)) : NULL;
+}
+
+uint64_t map_iter_get_hash(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? iter_pair(iter)->hash : 0;
+}
+
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n) {
+    size_t stored = 0;
+
+    for ( ; stored < n && map_iter_has_next(iter) ; stored++) {
+        pair_t *current = iter_pair(iter);
+        if (keys != NULL) keys[stored] = current->key;
+        if (values != NULL) values[stored] = pair_value(iter->hash, current);
+
+        iter->current_index++;
+        next_iter_index(iter);
+    }
+
+    return stored;
+}
+
+/******************** static functions definitions ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount) {
+    size_t capacity = hash_capacity_for(amount);
+    if (capacity == 0) return NULL;
+
+    Map hash = (Map)malloc(sizeof(struct hash_t));
+    if (hash == NULL) return NULL;
+
+    hash->value_size = value_size;
+    hash->stride = sizeof(pair_t) + (value_size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+    hash->table = hash_table_create(hash, capacity);
+    hash->removed = value_size != 0 ? malloc(value_size) : NULL;
+    if (hash->table == NULL || (value_size != 0 && hash->removed == NULL)) {
+        free(hash->table);
+        free(hash->removed);
+        free(hash);
+        return NULL;
+    }
+
+    hash->capacity = capacity;
+    hash->size = 0;
+    hash->deleted = 0;
+    hash->old_table = NULL;
+    hash->old_capacity = 0;
+    hash->old_size = 0;
+    hash->migrated = 0;
+    hash->destroy = value_destroy;
+    hash->hash_func = hash_func != NULL ? hash_func : hash_wy;
+    hash->seed = seed;
+    memset(&hash->stats, 0, sizeof(map_stats_t));
+
+    return hash;
+}
+
+/* The memory is zeroed by `calloc` (which is an EMPTY slot), so big tables are usually
+given by the system without having to write every slot while the Map is resized. */
+static pair_t *hash_table_create(Map hash, size_t capacity) {
+    if (capacity > SIZE_MAX / hash->stride) return NULL;
+
+    return (pair_t*)calloc(capacity, hash->stride);
+}
+
+static void hash_table_destroy(Map hash, pair_t *table, size_t capacity) {
+    for (size_t i = 0 ; i < capacity ; i++) {
+        pair_t *current = hash_pair(hash, table, i);
+        if (current->state != TAKEN) continue;
+        free(current->key);
+        if (hash->destroy != NULL) (hash->destroy)(pair_value(hash, current));
+    }
+
+    free(table);
+}
+
+/* Replaces the table with an empty one of the new capacity, and keeps the current one as
+the old table from which the pairs will be migrated. There must not be another migration
+in progress. */
+static bool hash_migration_start(Map hash, size_t new_capacity) {
+    clock_t start = clock();
+    pair_t *new_table = hash_table_create(hash, new_capacity);
+    if (new_table == NULL) return false;
+
+    hash->old_table = hash->table;
+    hash->old_capacity = hash->capacity;
+    hash->old_size = hash->size;
+    hash->migrated = 0;
+
+    hash->table = new_table;
+    hash->capacity = new_capacity;
+    hash->deleted = 0;
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return true;
+}
+
+/* Moves the pairs of, at most, the given amount of slots of the old table to the new one.
+The moved slots are marked as deleted, so the old table can still be searched. When every
+slot was migrated, the old table is freed. */
+static void hash_migration_step(Map hash, size_t slots) {
+    if (hash->old_table == NULL) return;
+
+    // Only the migrations finished at once are timed, a clock per step would slow every operation
+    bool timed = slots >= hash->old_capacity;
+    clock_t start = timed ? clock() : 0;
+
+    for ( ; slots > 0 && hash->migrated < hash->old_capacity ; slots--, hash->migrated++) {
+        pair_t *current = hash_pair(hash, hash->old_table, hash->migrated);
+        if (current->state != TAKEN) continue;
+
+        size_t index = hash_free_index(hash, hash->table, hash->capacity, current->hash);
+        memcpy(hash_pair(hash, hash->table, index), current, hash->stride);
+        current->state = DELETED;
+        current->key = NULL;
+        hash->old_size--;
+    }
+
+    if (hash->migrated < hash->old_capacity) return;
+
+    free(hash->old_table);
+    hash->old_table = NULL;
+    hash->old_capacity = 0;
+    hash->old_size = 0;
+    hash->migrated = 0;
+
+    if (timed) hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static pair_t *hash_pair(Map hash, pair_t *table, size_t index) {
+    return (pair_t*)((char*)table + index * hash->stride);
+}
+
+// Returns the value of the pair, or the address of its bytes if the Map stores them
+static void *pair_value(Map hash, pair_t *pair) {
+    return hash->value_size != 0 ? (void*)(pair + 1) : pair->value;
+}
+
+// Returns the pair with the given key from any of the tables, or NULL if it is not stored
+static pair_t *hash_find(Map hash, const void *key, size_t len, uint64_t h) {
+    size_t index = hash_search(hash, hash->table, hash->capacity, key, len, h);
+    if (index != NOT_FOUND) return hash_pair(hash, hash->table, index);
+    if (hash->old_table == NULL) return NULL;
+
+    index = hash_search(hash, hash->old_table, hash->old_capacity, key, len, h);
+
+    return index != NOT_FOUND ? hash_pair(hash, hash->old_table, index) : NULL;
+}
+
+static size_t hash_search(Map hash, pair_t *table, size_t capacity, const void *key, size_t len, uint64_t h) {
+    size_t index = (size_t)h & (capacity-1);
+    pair_t *current;
+
+    for ( ; hash_pair(hash, table, index)->state != EMPTY ; index = (index+1) & (capacity-1)) {
+        current = hash_pair(hash, table, index);
+        COUNT(hash->stats.probes);
+        if (current->state == TAKEN && current->hash == h && current->len == len && memcmp(current->key, key, len) == 0) return index;
+    }
+
+    return NOT_FOUND;
+}
+
+// Returns the index of the first empty slot in the probe sequence of the hash
+static size_t hash_free_index(Map hash, pair_t *table, size_t capacity, uint64_t h) {
+    size_t index = (size_t)h & (capacity-1);
+    while (hash_pair(hash, table, index)->state != EMPTY) index = (index+1) & (capacity-1);
+
+    return index;
+}
+
+/* Adds the probe lengths of the pairs of the table, from the given index on, to the stats.
+The sum of the lengths is kept in `average_probe_length` until every table is counted. */
+static void hash_table_stats(Map hash, pair_t *table, size_t capacity, size_t from, map_stats_t *stats) {
+    for (size_t i = from ; i < capacity ; i++) {
+        pair_t *current = hash_pair(hash, table, i);
+        if (current->state != TAKEN) continue;
+
+        size_t length = (i - ((size_t)current->hash & (capacity-1))) & (capacity-1);
+        stats_add_probe_length(stats, length);
+        stats->average_probe_length += (double)length;
+    }
+}
+
+/* Searches the keys in batches of BATCH_SIZE: first every key of the batch is hashed and the
+memory of its expected slot is prefetched, and then they are searched. Either `values` or
+`found` can be NULL. */
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found) {
+    if (hash == NULL) return 0;
+
+    uint64_t hashes[BATCH_SIZE];
+    size_t lens[BATCH_SIZE];
+    size_t stored = 0;
+
+    for (size_t start = 0 ; start < n ; start += BATCH_SIZE) {
+        size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            lens[i] = strlen(keys[start + i]);
+            hashes[i] = hash_key(hash, keys[start + i], lens[i]);
+            PREFETCH(hash_pair(hash, hash->table, (size_t)hashes[i] & (hash->capacity-1)));
+            if (hash->old_table != NULL) PREFETCH(hash_pair(hash, hash->old_table, (size_t)hashes[i] & (hash->old_capacity-1)));
+        }
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            pair_t *pair = hash_find(hash, keys[start + i], lens[i], hashes[i]);
+            COUNT(hash->stats.gets);
+            bool is_stored = pair != NULL;
+            void *value = is_stored ? pair_value(hash, pair) : NULL;
+            if (values != NULL) values[start + i] = value;
+            if (found != NULL) found[start + i] = is_stored;
+            if (is_stored) stored++;
+        }
+    }
+
+    return stored;
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t hash_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_CAPACITY;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
+/* The indexes from 0 to `capacity` are for `table`, and the ones after that are for
+`old_table`. */
+static pair_t *iter_pair(const MapIterator iter) {
+    Map hash = iter->hash;
+
+    return iter->current_index < hash->capacity ? hash_pair(hash, hash->table, iter->current_index) : hash_pair(hash, hash->old_table, iter->current_index - hash->capacity);
+}
+
+static void next_iter_index(MapIterator iter) {
+    while (map_iter_has_next(iter) && iter_pair(iter)->state != TAKEN) iter->current_index++;
+}
+
+// Returns a copy of the key followed by a '\0'
+static char *key_copy(const void *key, size_t len) {
+    char *copy = (char*)malloc((len+1) * sizeof(char));
+    if (copy == NULL) return NULL;
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+
+    return copy;
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "int_map.h"
+#include "map_hash.h"
+
+#define INITIAL_CAPACITY 16
+#define VARIATION_CAPACITY 2
+// The greatest power of two of a size_t
+#define MAX_CAPACITY (SIZE_MAX / 2 + 1)
+#define MIN_CHARGE_FACTOR 0.15
+#define MAX_CHARGE_FACTOR 0.65
+
+/******************** structure definition ********************/
+
+// A slot is only MISPLACED while the table is purged, until its pair is placed again
+typedef enum {
+    EMPTY = 0,
+    TAKEN,
+    DELETED,
+    MISPLACED
+} state_t;
+
+/* The key is stored inside the pair, and its hash is cheap to compute again, so the pairs
+take 24 bytes and the table is resized without storing the hashes. */
+typedef struct int_pair {
+    uint64_t key;
+    void *value;
+    state_t state;
+} int_pair_t;
+
+// The capacity is always a power of two, so the index of a hash is `hash & (capacity-1)`
+struct int_map_t {
+    int_pair_t *table;
+    size_t capacity;
+    size_t size;
+    size_t deleted;
+    destroy_func_t destroy;
+    uint64_t seed;
+};
+
+/******************** static functions declarations ********************/
+
+static int_pair_t *imap_table_create(size_t capacity);
+static void imap_table_destroy(int_pair_t *table, size_t capacity, destroy_func_t value_destroy);
+static bool imap_table_resize(IntMap map, size_t new_capacity);
+static void imap_table_purge(IntMap map);
+static size_t imap_search(IntMap map, uint64_t key);
+static size_t imap_expected_index(IntMap map, uint64_t key, size_t capacity);
+static size_t imap_capacity_for(size_t amount);
+
+/******************** Int Map operations definitions ********************/
+
+IntMap imap_create(destroy_func_t value_destroy) {
+    IntMap map = (IntMap)malloc(sizeof(struct int_map_t));
+    if (map == NULL) return NULL;
+
+    map->table = imap_table_create(INITIAL_CAPACITY);
+    if (map->table == NULL) {
+        free(map);
+        return NULL;
+    }
+
+    map->capacity = INITIAL_CAPACITY;
+    map->size = 0;
+    map->deleted = 0;
+    map->destroy = value_destroy;
+    map->seed = hash_random_seed();
+
+    return map;
+}
+
+void imap_destroy(IntMap map) {
+    if (map == NULL) return;
+
+    imap_table_destroy(map->table, map->capacity, map->destroy);
+    free(map);
+}
+
+size_t imap_size(IntMap map) {
+    return map != NULL ? map->size : 0;
+}
+
+bool imap_reserve(IntMap map, size_t amount) {
+    if (map == NULL) return false;
+
+    size_t new_capacity = imap_capacity_for(amount);
+    if (new_capacity == 0) return false;
+
+    return new_capacity <= map->capacity || imap_table_resize(map, new_capacity);
+}
+
+bool imap_put(IntMap map, uint64_t key, void *value) {
+    bool inserted;
+    void **current = imap_entry(map, key, &inserted);
+    if (current == NULL) return false;
+
+    if (!inserted && map->destroy != NULL) (map->destroy)(*current);
+    *current = value;
+
+    return true;
+}
+
+void **imap_entry(IntMap map, uint64_t key, bool *inserted) {
+    if (map == NULL) return NULL;
+
+    float charge_factor = (float)(map->size + map->deleted) / (float)map->capacity;
+    if (charge_factor > MAX_CHARGE_FACTOR) {
+        // When most of the load are deleted slots, the table is rebuilt in place with the same capacity
+        if ((float)(map->size + 1) / (float)map->capacity <= MAX_CHARGE_FACTOR / VARIATION_CAPACITY) imap_table_purge(map);
+        else if (!imap_table_resize(map, map->capacity * VARIATION_CAPACITY)) return NULL;
+    }
+
+    int_pair_t *pair = &map->table[imap_search(map, key)];
+    bool is_new = pair->state == EMPTY;
+
+    if (is_new) {
+        map->size++;
+        pair->key = key;
+        pair->value = NULL;
+        pair->state = TAKEN;
+    }
+    if (inserted != NULL) *inserted = is_new;
+
+    return &pair->value;
+}
+
+bool imap_contains(IntMap map, uint64_t key) {
+    if (map == NULL) return false;
+
+    return map->table[imap_search(map, key)].state == TAKEN;
+}
+
+void *imap_get(IntMap map, uint64_t key) {
+    if (map == NULL) return NULL;
+
+    size_t index = imap_search(map, key);
+
+    return map->table[index].state == TAKEN ? map->table[index].value : NULL;
+}
+
+void *imap_remove(IntMap map, uint64_t key) {
+    if (map == NULL) return NULL;
+
+    size_t index = imap_search(map, key);
+    if (map->table[index].state != TAKEN) return NULL;
+
+    map->size--;
+    map->deleted++;
+    map->table[index].state = DELETED;
+    void *deleted = map->table[index].value;
+
+    float charge_factor = (float)map->size / (float)map->capacity;
+    if (charge_factor < MIN_CHARGE_FACTOR && map->capacity >= INITIAL_CAPACITY * VARIATION_CAPACITY) imap_table_resize(map, map->capacity / VARIATION_CAPACITY);
+
+    return deleted;
+}
+
+void imap_for_each(IntMap map, int_visit_func_t visit, void *extra) {
+    if (map == NULL) return;
+
+    for (size_t i = 0 ; i < map->capacity ; i++) {
+        int_pair_t *current = &map->table[i];
+        if (current->state == TAKEN && !visit(current->key, current->value, extra)) break;
+    }
+}
+
+/******************** static functions definitions ********************/
+
+static int_pair_t *imap_table_create(size_t capacity) {
+    if (capacity > SIZE_MAX / sizeof(int_pair_t)) return NULL;
+
+    return (int_pair_t*)calloc(capacity, sizeof(int_pair_t));
+}
+
+static void imap_table_destroy(int_pair_t *table, size_t capacity, destroy_func_t value_destroy) {
+    for (size_t i = 0 ; value_destroy != NULL && i < capacity ; i++) {
+        if (table[i].state == TAKEN) (value_destroy)(table[i].value);
+    }
+
+    free(table);
+}
+
+static bool imap_table_resize(IntMap map, size_t new_capacity) {
+    int_pair_t *new_table = imap_table_create(new_capacity);
+    if (new_table == NULL) return false;
+
+    for (size_t i = 0 ; i < map->capacity ; i++) {
+        if (map->table[i].state != TAKEN) continue;
+
+        size_t index = imap_expected_index(map, map->table[i].key, new_capacity);
+        while (new_table[index].state != EMPTY) index = (index+1) & (new_capacity-1);
+        new_table[index] = map->table[i];
+    }
+    free(map->table);
+
+    map->table = new_table;
+    map->capacity = new_capacity;
+    map->deleted = 0;
+
+    return true;
+}
+
+/* Removes the deleted slots without allocating another table, like the purge of the Map:
+every pair is marked as misplaced and then placed again at the first slot of its probe
+sequence that is not taken, swapping it with the misplaced pair found there, if any, which is
+placed next. The searches never go through a misplaced slot, so emptying it before placing
+its pair keeps every placed pair reachable. */
+static void imap_table_purge(IntMap map) {
+    for (size_t i = 0 ; i < map->capacity ; i++) {
+        map->table[i].state = map->table[i].state == TAKEN ? MISPLACED : EMPTY;
+    }
+
+    for (size_t i = 0 ; i < map->capacity ; i++) {
+        if (map->table[i].state != MISPLACED) continue;
+
+        int_pair_t carried = map->table[i];
+        map->table[i].state = EMPTY;
+
+        for (bool placing = true ; placing ; ) {
+            size_t index = imap_expected_index(map, carried.key, map->capacity);
+            while (map->table[index].state == TAKEN) index = (index+1) & (map->capacity-1);
+
+            int_pair_t swap = map->table[index];
+            placing = swap.state == MISPLACED;
+            map->table[index] = carried;
+            map->table[index].state = TAKEN;
+            carried = swap;
+        }
+    }
+    map->deleted = 0;
+}
+
+// Returns the index of the pair of the key, or of the first empty slot where it would be
+static size_t imap_search(IntMap map, uint64_t key) {
+    size_t index = imap_expected_index(map, key, map->capacity);
+
+    for ( ; map->table[index].state != EMPTY ; index = (index+1) & (map->capacity-1)) {
+        if (map->table[index].state == TAKEN && map->table[index].key == key) return index;
+    }
+
+    return index;
+}
+
+/* The key goes through the finalizer of MurmurHash3 with the seed of the Int Map, so
+consecutive keys are spread over the whole table. */
+static size_t imap_expected_index(IntMap map, uint64_t key, size_t capacity) {
+    return (size_t)hash_finalize(key ^ map->seed) & (capacity-1);
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t imap_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_CAPACITY;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
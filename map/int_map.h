@@ -0,0 +1,56 @@
+#ifndef _INT_MAP_H
+#define _INT_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "map.h"
+
+/******************** Int Map structures declarations ********************/
+
+/* A function for the internal iterator of the Int Map, which works like `visit_func_t` for
+an integer key. */
+typedef bool (*int_visit_func_t)(uint64_t key, void *value, void *extra);
+/* A data structure that stores `key-value` pairs whose keys are 64-bit integers. The keys
+are stored inside the table, so they are neither copied nor compared as strings. */
+typedef struct int_map_t *IntMap;
+
+/******************** Int Map operations declarations ********************/
+
+/* Returns an instance of an empty Int Map.
+
+PRE:
+- `value_destroy` works like the one given to `map_create`.
+
+POST:
+- if there is not enough memory for the Int Map, the function will return NULL. */
+IntMap imap_create(destroy_func_t value_destroy);
+
+/* Frees the memory where the Int Map is allocated. */
+void imap_destroy(IntMap map);
+
+/* Returns the amount of pairs stored in the Int Map. */
+size_t imap_size(IntMap map);
+
+/* Works like `map_reserve`. */
+bool imap_reserve(IntMap map, size_t amount);
+
+/* Works like `map_put`. */
+bool imap_put(IntMap map, uint64_t key, void *value);
+
+/* Works like `map_entry`. */
+void **imap_entry(IntMap map, uint64_t key, bool *inserted);
+
+/* Works like `map_contains`. */
+bool imap_contains(IntMap map, uint64_t key);
+
+/* Works like `map_get`. */
+void *imap_get(IntMap map, uint64_t key);
+
+/* Works like `map_remove`. */
+void *imap_remove(IntMap map, uint64_t key);
+
+/* Works like `map_for_each`. */
+void imap_for_each(IntMap map, int_visit_func_t visit, void *extra);
+
+#endif // _INT_MAP_H
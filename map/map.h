@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /******************** Map structures declarations ********************/
 
@@ -11,8 +12,46 @@ typedef void (*destroy_func_t)(void*);
 /* A function for the internal iterators which returns a boolean value to decide if the 
 iteration continues or not. It receives an `extra` parameter that can be NULL. */
 typedef bool (*visit_func_t)(const char*, void*, void *extra);
+/* A function that returns the hash of the `len` bytes of a key. Keys that are equal must
+have the same hash for the same `seed`. */
+typedef uint64_t (*hash_func_t)(const void *key, size_t len, uint64_t seed);
+/* A function that receives the value of a pair, or NULL if the pair was just `inserted`, 
+and returns the value that replaces it. It receives an `extra` parameter that can be NULL. */
+typedef void *(*update_func_t)(void *value, bool inserted, void *extra);
+// The amount of probe lengths that have their own counter in the stats of a Map
+#define MAP_PROBE_LENGTHS 16
+/* A snapshot of how a Map is using its table. The probe length of a pair is the amount of 
+slots (or groups of slots, for the Swiss Table) that are checked before its own when its key 
+is searched, so it is 0 for a pair at its expected slot. */
+typedef struct map_stats {
+    size_t size;
+    size_t capacity;
+    // The slots that are marked as deleted, which still make the searches longer
+    size_t deleted;
+    // The amount of pairs of each probe length, the last one counts every longer pair too
+    size_t probe_lengths[MAP_PROBE_LENGTHS];
+    size_t max_probe_length;
+    double average_probe_length;
+    // The times the table was rebuilt, and the processor time spent on it
+    size_t resizes;
+    double resize_seconds;
+    /* The operations since the Map was created, and the slots (or groups) checked by all 
+    their searches. They are only counted if the Map is compiled with `MAP_STATS_COUNTERS` 
+    defined, and they are 0 otherwise. */
+    size_t gets;
+    size_t puts;
+    size_t removes;
+    size_t probes;
+} map_stats_t;
 // A data structure that stores `key-value` pairs.
 typedef struct hash_t *Map;
+/* The state of an external iterator for the Map. Its fields are only used by the 
+implementations: it is declared here so that an iterator can be a local variable, set up by 
+`map_iter_init` without allocating it. */
+typedef struct hash_iter_t {
+    Map hash;
+    size_t current_index;
+} map_iter_t;
 // The external iterator for the Map
 typedef struct hash_iter_t *MapIterator;
 
@@ -29,12 +68,81 @@ POST:
 - if there is not enough memory for the Map, the function will return NULL. */
 Map map_create(destroy_func_t value_destroy);
 
+/* Returns an instance of an empty Map that hashes its keys with the given function and 
+seed. The Map created by `map_create` uses the built-in hash function with a seed that 
+is different for every Map, so the keys that collide can not be predicted.
+
+PRE:
+- `value_destroy` works like the one given to `map_create`.
+- `hash_func` is the function used to hash the keys, it receives the key without its 
+'\0' terminator. If NULL is given, the built-in hash function is used.
+
+POST:
+- if there is not enough memory for the Map, the function will return NULL. */
+Map map_create_with_hash(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed);
+
+/* Returns an instance of an empty Map with room for `capacity` pairs, so they can be put 
+without resizing the Map.
+
+PRE:
+- `value_destroy` works like the one given to `map_create`.
+
+POST:
+- if there is not enough memory for the Map, the function will return NULL. */
+Map map_create_with_capacity(destroy_func_t value_destroy, size_t capacity);
+
+/* Returns an instance of an empty Map that stores each value inside the Map, as a copy of 
+`value_size` bytes, instead of a pointer to it. The pointers that the other operations 
+receive and return as values are the addresses of those bytes:
+- `map_put` copies the bytes the given value points to.
+- `map_get`, the iterators and the visit functions give the address of the value inside the 
+Map, which can be used until the Map is changed by another operation.
+- `map_entry` returns the address of the value itself (which must be cast to its type), and 
+an added value has all its bytes set to zero.
+- `update` receives the address of the value, and if it returns another address, its bytes 
+are copied into the value.
+- `map_remove` returns the address of a copy of the removed value, which can be used until 
+the Map is changed by another operation.
+
+PRE:
+- `value_size` is greater than 0.
+- `value_destroy` receives the address of a value inside the Map, to free the memory that 
+the value points to, if any. If NULL is given, it is not called.
+
+POST:
+- if there is not enough memory for the Map, the function will return NULL. */
+Map map_create_sized(size_t value_size, destroy_func_t value_destroy);
+
 /* Frees the memory where the Map is allocated. */
 void map_destroy(Map map);
 
 /* Returns the amount of pairs stored in the Map. */
 size_t map_size(Map map);
 
+/* Makes room for `amount` pairs in total, so the Map is not resized while it stores that 
+amount of pairs. If there is already enough room, the Map does not change.
+
+POST:
+- Returns false if there is not enough memory, in which case the Map does not change.
+- Removing pairs may still make the Map shrink. */
+bool map_reserve(Map map, size_t amount);
+
+/* Reduces the memory used by the Map to the least needed for the pairs it stores.
+
+POST:
+- Returns false if there is not enough memory, in which case the Map does not change. */
+bool map_shrink_to_fit(Map map);
+
+/* Adds a filter to the Map that tells most of the keys that are not stored apart without
+searching the table for them, reading a single cache line instead. It is meant for Maps
+where most lookups miss: it takes about 4 bytes for each slot of the table and makes puts
+and removes a little slower. Implementations whose searches for a missing key already read
+about one cache line do not add it. If the Map already has a filter, it does not change.
+
+POST:
+- Returns false if there is not enough memory, in which case the Map does not change. */
+bool map_enable_filter(Map map);
+
 /* If the key is not stored in the Map, adds the `key-value` pair to the Map; otherwise, 
 updates the value of the pair.
 
@@ -43,15 +151,76 @@ POST:
 issue with the operation. */
 bool map_put(Map map, char *key, void *value);
 
+/* Works like `map_put`, but the key is made of the first `len` bytes of `key`, which do not 
+need to end with a '\0' and may have zero bytes. A key given as a string to the other 
+operations is the same as the bytes of the string without its '\0'.
+
+POST:
+- The Map stores a copy of the key followed by a '\0', which is the one given to the 
+iterators. */
+bool map_put_n(Map map, const void *key, size_t len, void *value);
+
+/* Returns the address where the value of the pair for the given key is stored, so the 
+value can be read and changed with a single search. If the key is not stored in the Map, 
+the pair is added with a NULL value.
+
+POST:
+- If `inserted` is not NULL, it is set to true if the pair was added, false if not.
+- The address can be used until the Map is changed by another operation.
+- If there is not enough memory to add the pair, the function returns NULL. */
+void **map_entry(Map map, char *key, bool *inserted);
+
+/* Works like `map_entry`, for a key made of the first `len` bytes of `key`. */
+void **map_entry_n(Map map, const void *key, size_t len, bool *inserted);
+
+/* Replaces the value of the pair for the given key with the one returned by `update`, 
+adding the pair if the key is not stored. The replaced value is not destroyed, since 
+`update` may return it again.
+
+POST:
+- Returns true if the value was updated, false if there is not enough memory to add the 
+pair, in which case `update` is not called. */
+bool map_update(Map map, char *key, update_func_t update, void *extra);
+
 /* Returns true if the key is stored in the Map, false if not. */
 bool map_contains(Map map, const char *key);
 
+/* Works like `map_contains`, for a key made of the first `len` bytes of `key`. */
+bool map_contains_n(Map map, const void *key, size_t len);
+
 /* Return the value of the pair for the given key.
 
 POST:
 - If the key is not stored in the Map, the function returns NULL. */
 void *map_get(Map map, const char *key);
 
+/* Works like `map_get`, for a key made of the first `len` bytes of `key`. The key is not 
+copied, so it can point into any buffer. */
+void *map_get_n(Map map, const void *key, size_t len);
+
+/* Stores in `values[i]` the value of the pair for `keys[i]`, for each one of the `n` keys. 
+It works like calling `map_get` for each key, but the keys are hashed in batches and the 
+memory where each of them is expected is requested before it is searched, so the lookups 
+do not wait for the memory one at a time.
+
+PRE:
+- `keys` and `values` are arrays of, at least, `n` elements.
+
+POST:
+- If a key is not stored in the Map, its value is NULL.
+- Returns the amount of keys that are stored in the Map. */
+size_t map_get_many(Map map, const char **keys, size_t n, void **values);
+
+/* Stores in `found[i]` whether `keys[i]` is stored in the Map, for each one of the `n` 
+keys. It works like `map_get_many`.
+
+PRE:
+- `keys` and `found` are arrays of, at least, `n` elements.
+
+POST:
+- Returns the amount of keys that are stored in the Map. */
+size_t map_contains_many(Map map, const char **keys, size_t n, bool *found);
+
 /* Remove and return the value of the pair with the given key. 
 
 POST:
@@ -60,6 +229,9 @@ POST:
 needed anymore. */
 void *map_remove(Map map, char *key);
 
+/* Works like `map_remove`, for a key made of the first `len` bytes of `key`. */
+void *map_remove_n(Map map, const void *key, size_t len);
+
 /* The internal iterator of the Map. Iterates through the pairs of the Map in no order, 
 applying the visit function to each one. If `visit(key, value, ...)` return false, the 
 iteration stops. 
@@ -71,6 +243,15 @@ the iteration and an extra parameter that could be NULL.
 `visit` function. */
 void map_for_each(Map map, visit_func_t visit, void* extra);
 
+/* Fills `stats` with the current state of the Map. It goes through the whole table, so it
+is meant for diagnostics rather than for every operation.
+
+POST:
+- Every counted get covers a call to `map_get`, `map_contains` or one of their variants, or 
+a single key given to `map_get_many` or `map_contains_many`; every counted put covers a call 
+to `map_put`, `map_entry`, `map_update` or one of their variants. */
+void map_stats(Map map, map_stats_t *stats);
+
 /******************** Map Iterator functions declarations ********************/
 
 /* Returns an instance of an external iterator for the Map. 
@@ -79,6 +260,13 @@ POST:
 - if there is not enough memory for the iterator, the function will return NULL. */
 MapIterator map_iter_create(Map map);
 
+/* Sets up `iter` as an external iterator for the Map, which works like the one returned by 
+`map_iter_create` but is not allocated, so it must not be given to `map_iter_destroy`.
+
+POST:
+- Returns `iter`, or NULL if `iter` or the Map is NULL. */
+MapIterator map_iter_init(map_iter_t *iter, Map map);
+
 /* Frees the memory where the Map iterator is allocated. */
 void map_iter_destroy(MapIterator iter);
 
@@ -97,4 +285,31 @@ POST:
 - If there are no elements left to iterate through, a NULL pointer will be returned. */
 const char *map_iter_get_current(const MapIterator iter);
 
+/* Returns the value of the current pair at the iteration, without searching its key, in the 
+same way as `map_get`.
+
+POST:
+- If there are no elements left to iterate through, a NULL pointer will be returned. */
+void *map_iter_get_value(const MapIterator iter);
+
+/* Returns the hash that the Map stores for the key of the current pair, so it does not have 
+to be hashed again. It is the hash given by the hash function of the Map, which each 
+implementation may mix again, so it can only be compared with the hashes of the Maps of the 
+same implementation with the same hash function and seed.
+
+POST:
+- If there are no elements left to iterate through, 0 will be returned. */
+uint64_t map_iter_get_hash(const MapIterator iter);
+
+/* Stores in `keys` and `values` the keys and values of the next `n` pairs of the iteration, 
+starting at the current one, and advances the iteration past them.
+
+PRE:
+- `keys` and `values` are arrays of, at least, `n` elements, or NULL if they are not needed.
+
+POST:
+- Returns the amount of pairs stored in the arrays, which is less than `n` only if there are 
+no pairs left to iterate through. */
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n);
+
 #endif // _MAP_H
\ No newline at end of file
@@ -0,0 +1,162 @@
+#ifndef _MAP_COMMON_H
+#define _MAP_COMMON_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "map_hash.h"
+
+/* The operations of map.h that every implementation defines in the same way, on top of its
+own `map_entry_n`, `map_contains_n`, `map_get_n`, `map_remove_n` and iteration. It is included
+by the source file of each implementation, after the definition of `struct hash_t` (which must
+have the `size`, `value_size`, `destroy`, `hash_func` and `seed` fields) and the declarations
+of its static functions, among them `hash_search_many`, `next_iter_index` and `hash_create`,
+which returns NULL if it can not make room for `amount` pairs. */
+
+/* The operations and the slots checked by the searches are only counted if the Map is
+compiled with `MAP_STATS_COUNTERS` defined, so they cost nothing otherwise. They are increased
+with relaxed atomic operations where the compiler has them, since the lookups of a concurrent
+Map or a Read Mostly Map run at the same time on the same Map. */
+#ifndef MAP_STATS_COUNTERS
+#define COUNT(counter) ((void)0)
+#elif defined(__GNUC__)
+#define COUNT(counter) ((void)__atomic_add_fetch(&(counter), 1, __ATOMIC_RELAXED))
+#else
+#define COUNT(counter) ((counter)++)
+#endif
+
+/******************** shared static functions definitions ********************/
+
+/* The hash given by the hash function goes through the finalizer of MurmurHash3, so even
+the lower bits used for the index depend on every bit of a weak hash. */
+static inline uint64_t hash_key(Map hash, const void *key, size_t len) {
+    return hash_finalize((hash->hash_func)(key, len, hash->seed));
+}
+
+// Counts a pair with the given probe length, the histogram and maximum of the stats must be zeroed first
+static inline void stats_add_probe_length(map_stats_t *stats, size_t length) {
+    stats->probe_lengths[length < MAP_PROBE_LENGTHS ? length : MAP_PROBE_LENGTHS - 1]++;
+    if (length > stats->max_probe_length) stats->max_probe_length = length;
+}
+
+/******************** Map operations definitions ********************/
+
+Map map_create(destroy_func_t value_destroy) {
+    return map_create_with_hash(value_destroy, NULL, hash_random_seed());
+}
+
+Map map_create_with_hash(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed) {
+    return hash_create(value_destroy, hash_func, seed, 0, 0);
+}
+
+Map map_create_sized(size_t value_size, destroy_func_t value_destroy) {
+    if (value_size == 0) return NULL;
+
+    return hash_create(value_destroy, NULL, hash_random_seed(), value_size, 0);
+}
+
+// The table is created with the capacity for the pairs, instead of growing a new Map into it
+Map map_create_with_capacity(destroy_func_t value_destroy, size_t capacity) {
+    return hash_create(value_destroy, NULL, hash_random_seed(), 0, capacity);
+}
+
+size_t map_size(Map hash) {
+    return hash != NULL ? hash->size : 0;
+}
+
+bool map_put(Map hash, char *key, void *value) {
+    return map_put_n(hash, key, strlen(key), value);
+}
+
+bool map_put_n(Map hash, const void *key, size_t len, void *value) {
+    bool inserted;
+    void **current = map_entry_n(hash, key, len, &inserted);
+    if (current == NULL) return false;
+
+    if (hash->value_size != 0) {
+        if (!inserted && hash->destroy != NULL) (hash->destroy)(current);
+        memmove(current, value, hash->value_size);
+        return true;
+    }
+
+    if (!inserted && hash->destroy != NULL) (hash->destroy)(*current);
+    *current = value;
+
+    return true;
+}
+
+void **map_entry(Map hash, char *key, bool *inserted) {
+    return map_entry_n(hash, key, strlen(key), inserted);
+}
+
+bool map_update(Map hash, char *key, update_func_t update, void *extra) {
+    bool inserted;
+    void **current = map_entry(hash, key, &inserted);
+    if (current == NULL) return false;
+
+    if (hash->value_size == 0) {
+        *current = update(*current, inserted, extra);
+        return true;
+    }
+
+    void *updated = update(current, inserted, extra);
+    if (updated != NULL && updated != (void*)current) memmove(current, updated, hash->value_size);
+
+    return true;
+}
+
+bool map_contains(Map hash, const char *key) {
+    return map_contains_n(hash, key, strlen(key));
+}
+
+size_t map_contains_many(Map hash, const char **keys, size_t n, bool *found) {
+    return hash_search_many(hash, keys, n, NULL, found);
+}
+
+void *map_get(Map hash, const char *key) {
+    return map_get_n(hash, key, strlen(key));
+}
+
+size_t map_get_many(Map hash, const char **keys, size_t n, void **values) {
+    return hash_search_many(hash, keys, n, values, NULL);
+}
+
+void *map_remove(Map hash, char *key) {
+    return map_remove_n(hash, key, strlen(key));
+}
+
+/******************** Map Iterator operations definitions ********************/
+
+MapIterator map_iter_create(Map hash) {
+    if (hash == NULL) return NULL;
+
+    MapIterator iter = (MapIterator)malloc(sizeof(map_iter_t));
+    if (iter == NULL) return NULL;
+
+    return map_iter_init(iter, hash);
+}
+
+MapIterator map_iter_init(map_iter_t *iter, Map hash) {
+    if (iter == NULL || hash == NULL) return NULL;
+
+    iter->hash = hash;
+    iter->current_index = 0;
+    next_iter_index(iter);
+
+    return iter;
+}
+
+void map_iter_destroy(MapIterator iter) {
+    free(iter);
+}
+
+bool map_iter_next(MapIterator iter) {
+    if (iter == NULL || !map_iter_has_next(iter)) return false;
+
+    iter->current_index++;
+    next_iter_index(iter);
+
+    return true;
+}
+
+#endif // _MAP_COMMON_H
@@ -0,0 +1,79 @@
+#ifndef _MAP_FILTER_H
+#define _MAP_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The filter that `map_enable_filter` adds to the implementations that use one, included by
+their source files only. */
+
+#define FILTER_BLOCK_SIZE 64
+#define FILTER_SLOTS_PER_BLOCK 16
+#define FILTER_HASHES 4
+#define FILTER_MAX_COUNT 15
+#define FILTER_MIX 0x9e3779b97f4a7c15ULL
+
+/* A counting Bloom filter split into blocks of one cache line, so a key only reads one of
+them. Each key adds one to FILTER_HASHES counters of 4 bits of its block. The hash is rotated
+by half its width before it is mixed again, so the counters come from its upper half while the
+index in the table comes from the lower one, and the block depends on every bit. A counter that
+reaches FILTER_MAX_COUNT can no longer tell how many keys it counts, so it stays there until
+the filter is rebuilt with the table. The blocks are aligned to the cache lines inside
+`memory`, which is NULL if the Map has no filter. */
+typedef struct filter {
+    void *memory;
+    uint8_t *blocks;
+    size_t mask;
+} filter_t;
+
+/******************** filter functions definitions ********************/
+
+// Creates an empty filter with a block for each FILTER_SLOTS_PER_BLOCK slots of the table
+static inline bool filter_create(filter_t *filter, size_t capacity) {
+    size_t blocks = capacity > FILTER_SLOTS_PER_BLOCK ? capacity / FILTER_SLOTS_PER_BLOCK : 1;
+
+    filter->memory = calloc(blocks * FILTER_BLOCK_SIZE + FILTER_BLOCK_SIZE, 1);
+    if (filter->memory == NULL) return false;
+
+    uintptr_t address = (uintptr_t)filter->memory;
+    filter->blocks = (uint8_t*)(address + (FILTER_BLOCK_SIZE - address % FILTER_BLOCK_SIZE) % FILTER_BLOCK_SIZE);
+    filter->mask = blocks - 1;
+
+    return true;
+}
+
+// Adds or removes a key with the given hash, which must be stored in the Map
+static inline void filter_update(filter_t *filter, uint64_t h, bool add) {
+    uint64_t mixed = (h >> 32 | h << 32) * FILTER_MIX;
+    uint8_t *block = filter->blocks + ((size_t)(mixed >> 32) & filter->mask) * FILTER_BLOCK_SIZE;
+
+    // Each counter takes 7 bits of the lower half of the mixed hash, a block has 128 of them
+    for (unsigned i = 0 ; i < FILTER_HASHES ; i++) {
+        unsigned counter = (unsigned)(mixed >> (7 * i)) & 127;
+        unsigned shift = (counter & 1) * 4;
+        unsigned count = (block[counter >> 1] >> shift) & 0xF;
+
+        if (count == FILTER_MAX_COUNT) continue;
+        count = add ? count + 1 : count - 1;
+        block[counter >> 1] = (uint8_t)((block[counter >> 1] & ~(0xF << shift)) | (count << shift));
+    }
+}
+
+/* Returns false if the key with the given hash is surely not stored in the Map, and true if
+it may be (or if the Map has no filter). */
+static inline bool filter_contains(const filter_t *filter, uint64_t h) {
+    if (filter->memory == NULL) return true;
+
+    uint64_t mixed = (h >> 32 | h << 32) * FILTER_MIX;
+    const uint8_t *block = filter->blocks + ((size_t)(mixed >> 32) & filter->mask) * FILTER_BLOCK_SIZE;
+
+    for (unsigned i = 0 ; i < FILTER_HASHES ; i++) {
+        unsigned counter = (unsigned)(mixed >> (7 * i)) & 127;
+        if (((block[counter >> 1] >> ((counter & 1) * 4)) & 0xF) == 0) return false;
+    }
+
+    return true;
+}
+
+#endif // _MAP_FILTER_H
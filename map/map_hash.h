@@ -0,0 +1,114 @@
+#ifndef _MAP_HASH_H
+#define _MAP_HASH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* The hash function and the seeds shared by the implementations of the Maps. It is only
+included by their source files, so every function is defined here as `static inline`. */
+
+#define HASH_P0 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+#define HASH_P2 0x8ebc6af09c88c6e3ULL
+#define HASH_P3 0x589965cc75374cc3ULL
+
+/******************** hash functions definitions ********************/
+
+static inline uint64_t hash_read64(const uint8_t *bytes) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+
+    return word;
+}
+
+static inline uint64_t hash_read32(const uint8_t *bytes) {
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+
+    return word;
+}
+
+// Multiplies both numbers into a 128-bit result and returns the XOR of its halves
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ unsigned __int128 product = (unsigned __int128)a * b;
+
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    uint64_t a_high = a >> 32, a_low = (uint32_t)a, b_high = b >> 32, b_low = (uint32_t)b;
+    uint64_t middle1 = a_high * b_low, middle2 = a_low * b_high, low = a_low * b_low;
+    uint64_t carry = ((low >> 32) + (uint32_t)middle1 + (uint32_t)middle2) >> 32;
+
+    return (a * b) ^ (a_high * b_high + (middle1 >> 32) + (middle2 >> 32) + carry);
+#endif
+}
+
+/* The finalizer of MurmurHash3: every bit of the result depends on every bit of `h`, so even
+the lower bits used for an index spread the keys of a weak hash. */
+static inline uint64_t hash_finalize(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/* A hash function from the wyhash family: it reads the key 8 bytes at a time (16 or 48 per
+step) and mixes them with 64-bit multiplications. */
+static inline uint64_t hash_wy(const void *key, size_t len, uint64_t seed) {
+    const uint8_t *bytes = (const uint8_t*)key;
+    uint64_t a = 0, b = 0;
+
+    seed ^= hash_mix(seed ^ HASH_P0, HASH_P1);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t middle = (len >> 3) << 2;
+            a = (hash_read32(bytes) << 32) | hash_read32(bytes + middle);
+            b = (hash_read32(bytes + len - 4) << 32) | hash_read32(bytes + len - 4 - middle);
+        } else if (len > 0) {
+            a = ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[len >> 1] << 8) | bytes[len - 1];
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            for ( ; i > 48 ; i -= 48, bytes += 48) {
+                seed = hash_mix(hash_read64(bytes) ^ HASH_P1, hash_read64(bytes + 8) ^ seed);
+                seed1 = hash_mix(hash_read64(bytes + 16) ^ HASH_P2, hash_read64(bytes + 24) ^ seed1);
+                seed2 = hash_mix(hash_read64(bytes + 32) ^ HASH_P3, hash_read64(bytes + 40) ^ seed2);
+            }
+            seed ^= seed1 ^ seed2;
+        }
+        for ( ; i > 16 ; i -= 16, bytes += 16) seed = hash_mix(hash_read64(bytes) ^ HASH_P1, hash_read64(bytes + 8) ^ seed);
+
+        // The last 16 bytes of the key are always read, even if some were already mixed
+        a = hash_read64(bytes + i - 16);
+        b = hash_read64(bytes + i - 8);
+    }
+
+    return hash_mix(hash_mix(a ^ HASH_P1, b ^ seed) ^ HASH_P0 ^ len, HASH_P1);
+}
+
+/* Returns a seed that is different for every call, so the keys that collide in a structure
+can not be predicted. Each source file that includes this header has its own counter, so its
+address is mixed in too, and the counter is increased atomically, as the structures may be
+created from several threads. */
+static inline uint64_t hash_random_seed(void) {
+    static uint64_t seeds_created = 0;
+
+    // The address of a local variable changes on every run if the system randomizes the stack
+    uint64_t seed = (uint64_t)time(NULL) ^ (uint64_t)clock() ^ (uint64_t)(uintptr_t)&seed;
+#ifdef __GNUC__
+    uint64_t created = __atomic_add_fetch(&seeds_created, 1, __ATOMIC_RELAXED);
+#else
+    uint64_t created = ++seeds_created;
+#endif
+
+    return hash_mix(seed ^ HASH_P0, (created ^ HASH_P1) + (uint64_t)(uintptr_t)&seeds_created);
+}
+
+#endif // _MAP_HASH_H
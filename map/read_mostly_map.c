@@ -0,0 +1,309 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "read_mostly_map.h"
+
+#define CACHE_LINE_SIZE 64
+#define OFFLINE 0
+
+/******************** structure definition ********************/
+
+/* A version of the Map, or a value, that was replaced by a writer and is freed once every
+online reader has seen an epoch equal or greater than the one it was retired at. */
+typedef struct retired {
+    Map table;
+    void *value;
+    bool destroy_value;
+    uint64_t epoch;
+    struct retired *next;
+} retired_t;
+
+/* `size` is the size of the current version, kept apart so it can be read without a
+reader. */
+struct read_mostly_map_t {
+    Map current;
+    size_t size;
+    uint64_t epoch;
+    pthread_mutex_t lock;
+    ReadMostlyReader readers;
+    retired_t *retired;
+    destroy_func_t value_destroy;
+};
+
+/* Each reader takes a whole cache line, so a reader that declares a quiescent state does not
+slow down the other ones. `seen` is the last epoch the reader saw, or OFFLINE. */
+struct read_mostly_reader_t {
+    uint64_t seen;
+    ReadMostlyMap map;
+    ReadMostlyReader next;
+    char padding[CACHE_LINE_SIZE - (sizeof(uint64_t) + 2 * sizeof(void*)) % CACHE_LINE_SIZE];
+};
+
+// The Map where the pairs are copied and whether every pair was copied
+typedef struct copy_state {
+    Map map;
+    bool ok;
+} copy_state_t;
+
+/******************** static functions declarations ********************/
+
+static Map version_current(ReadMostlyReader reader);
+static Map version_copy(Map current, size_t extra);
+static bool copy_pair(const char *key, void *value, void *extra);
+static void version_publish(ReadMostlyMap map, Map next, retired_t *retired);
+static void reclaim(ReadMostlyMap map);
+static void retired_free(ReadMostlyMap map, retired_t *retired);
+static bool destroy_value(const char *key, void *value, void *extra);
+
+/******************** Read Mostly Map operations definitions ********************/
+
+ReadMostlyMap read_mostly_map_create(destroy_func_t value_destroy) {
+    ReadMostlyMap map = (ReadMostlyMap)malloc(sizeof(struct read_mostly_map_t));
+    if (map == NULL) return NULL;
+
+    map->current = map_create(NULL);
+    if (map->current == NULL) {
+        free(map);
+        return NULL;
+    }
+    if (pthread_mutex_init(&map->lock, NULL) != 0) {
+        map_destroy(map->current);
+        free(map);
+        return NULL;
+    }
+
+    map->size = 0;
+    map->epoch = OFFLINE + 1;
+    map->readers = NULL;
+    map->retired = NULL;
+    map->value_destroy = value_destroy;
+
+    return map;
+}
+
+void read_mostly_map_destroy(ReadMostlyMap map) {
+    if (map == NULL) return;
+
+    while (map->retired != NULL) {
+        retired_t *next = map->retired->next;
+        retired_free(map, map->retired);
+        map->retired = next;
+    }
+
+    if (map->value_destroy != NULL) map_for_each(map->current, destroy_value, map);
+    map_destroy(map->current);
+    pthread_mutex_destroy(&map->lock);
+    free(map);
+}
+
+size_t read_mostly_map_size(ReadMostlyMap map) {
+    if (map == NULL) return 0;
+
+    return __atomic_load_n(&map->size, __ATOMIC_RELAXED);
+}
+
+bool read_mostly_map_put(ReadMostlyMap map, char *key, void *value) {
+    if (map == NULL) return false;
+
+    retired_t *retired = (retired_t*)malloc(sizeof(retired_t));
+    if (retired == NULL) return false;
+
+    pthread_mutex_lock(&map->lock);
+
+    Map current = map->current;
+    Map next = version_copy(current, 1);
+    if (next == NULL || !map_put(next, key, value)) {
+        pthread_mutex_unlock(&map->lock);
+        map_destroy(next);
+        free(retired);
+        return false;
+    }
+
+    retired->value = map_get(current, key);
+    retired->destroy_value = map_contains(current, key) && retired->value != value;
+    version_publish(map, next, retired);
+
+    pthread_mutex_unlock(&map->lock);
+
+    return true;
+}
+
+bool read_mostly_map_contains(ReadMostlyReader reader, const char *key) {
+    Map current = version_current(reader);
+
+    return current != NULL && map_contains(current, key);
+}
+
+void *read_mostly_map_get(ReadMostlyReader reader, const char *key) {
+    Map current = version_current(reader);
+
+    return current != NULL ? map_get(current, key) : NULL;
+}
+
+bool read_mostly_map_remove(ReadMostlyMap map, char *key) {
+    if (map == NULL) return false;
+
+    retired_t *retired = (retired_t*)malloc(sizeof(retired_t));
+    if (retired == NULL) return false;
+
+    pthread_mutex_lock(&map->lock);
+
+    Map current = map->current;
+    Map next = map_contains(current, key) ? version_copy(current, 0) : NULL;
+    if (next == NULL) {
+        pthread_mutex_unlock(&map->lock);
+        free(retired);
+        return false;
+    }
+
+    retired->value = map_get(current, key);
+    retired->destroy_value = true;
+    map_remove(next, key);
+    version_publish(map, next, retired);
+
+    pthread_mutex_unlock(&map->lock);
+
+    return true;
+}
+
+void read_mostly_map_for_each(ReadMostlyReader reader, visit_func_t visit, void *extra) {
+    Map current = version_current(reader);
+
+    if (current != NULL) map_for_each(current, visit, extra);
+}
+
+/******************** Read Mostly Reader operations definitions ********************/
+
+ReadMostlyReader read_mostly_reader_create(ReadMostlyMap map) {
+    if (map == NULL) return NULL;
+
+    void *memory = NULL;
+    if (posix_memalign(&memory, CACHE_LINE_SIZE, sizeof(struct read_mostly_reader_t)) != 0) return NULL;
+    ReadMostlyReader reader = (ReadMostlyReader)memory;
+    reader->map = map;
+
+    pthread_mutex_lock(&map->lock);
+    reader->seen = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+    reader->next = map->readers;
+    map->readers = reader;
+    pthread_mutex_unlock(&map->lock);
+
+    return reader;
+}
+
+void read_mostly_reader_destroy(ReadMostlyReader reader) {
+    if (reader == NULL) return;
+
+    ReadMostlyMap map = reader->map;
+    pthread_mutex_lock(&map->lock);
+    ReadMostlyReader *link = &map->readers;
+    while (*link != reader) link = &(*link)->next;
+    *link = reader->next;
+    pthread_mutex_unlock(&map->lock);
+
+    free(reader);
+}
+
+void read_mostly_reader_quiescent(ReadMostlyReader reader) {
+    if (reader == NULL) return;
+
+    uint64_t epoch = __atomic_load_n(&reader->map->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&reader->seen, epoch, __ATOMIC_SEQ_CST);
+}
+
+void read_mostly_reader_offline(ReadMostlyReader reader) {
+    if (reader == NULL) return;
+
+    __atomic_store_n(&reader->seen, OFFLINE, __ATOMIC_SEQ_CST);
+}
+
+void read_mostly_reader_online(ReadMostlyReader reader) {
+    if (reader == NULL) return;
+
+    /* Taking the lock of the writers orders this with any publication: either the writer
+    sees the reader online, or the reader sees the version it published. */
+    pthread_mutex_lock(&reader->map->lock);
+    read_mostly_reader_quiescent(reader);
+    pthread_mutex_unlock(&reader->map->lock);
+}
+
+/******************** static functions definitions ********************/
+
+/* The only access of the readers to shared memory is this load, so the lookups never wait
+for the writers. Returns NULL for an offline reader, since the version it would load could
+be freed at any time. Only the thread of the reader changes `seen`. */
+static Map version_current(ReadMostlyReader reader) {
+    if (reader == NULL || __atomic_load_n(&reader->seen, __ATOMIC_RELAXED) == OFFLINE) return NULL;
+
+    return __atomic_load_n(&reader->map->current, __ATOMIC_ACQUIRE);
+}
+
+static Map version_copy(Map current, size_t extra) {
+    Map copy = map_create_with_capacity(NULL, map_size(current) + extra);
+    if (copy == NULL) return NULL;
+
+    copy_state_t state = {copy, true};
+    map_for_each(current, copy_pair, &state);
+    if (!state.ok) {
+        map_destroy(copy);
+        return NULL;
+    }
+
+    return copy;
+}
+
+static bool copy_pair(const char *key, void *value, void *extra) {
+    copy_state_t *state = (copy_state_t*)extra;
+    state->ok = map_put(state->map, (char*)key, value);
+
+    return state->ok;
+}
+
+/* Publishes the new version before advancing the epoch, so any reader that sees the new epoch
+also sees the new version, and the retired one is freed after every reader has seen it. */
+static void version_publish(ReadMostlyMap map, Map next, retired_t *retired) {
+    retired->table = map->current;
+    __atomic_store_n(&map->current, next, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&map->size, map_size(next), __ATOMIC_RELAXED);
+    retired->epoch = __atomic_add_fetch(&map->epoch, 1, __ATOMIC_SEQ_CST);
+
+    retired->next = map->retired;
+    map->retired = retired;
+    reclaim(map);
+}
+
+static void reclaim(ReadMostlyMap map) {
+    uint64_t oldest = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+    for (ReadMostlyReader reader = map->readers ; reader != NULL ; reader = reader->next) {
+        uint64_t seen = __atomic_load_n(&reader->seen, __ATOMIC_SEQ_CST);
+        if (seen != OFFLINE && seen < oldest) oldest = seen;
+    }
+
+    retired_t **link = &map->retired;
+    while (*link != NULL) {
+        retired_t *retired = *link;
+        if (retired->epoch > oldest) {
+            link = &retired->next;
+            continue;
+        }
+
+        *link = retired->next;
+        retired_free(map, retired);
+    }
+}
+
+static void retired_free(ReadMostlyMap map, retired_t *retired) {
+    if (retired->destroy_value && map->value_destroy != NULL) map->value_destroy(retired->value);
+    map_destroy(retired->table);
+    free(retired);
+}
+
+static bool destroy_value(const char *key, void *value, void *extra) {
+    ReadMostlyMap map = (ReadMostlyMap)extra;
+    map->value_destroy(value);
+
+    return true;
+}
@@ -0,0 +1,110 @@
+#ifndef _READ_MOSTLY_MAP_H
+#define _READ_MOSTLY_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+
+/******************** Read Mostly Map structures declarations ********************/
+
+/* A Map for many threads that read it all the time and rarely change it. The lookups do
+not take any lock nor write to any shared memory: they search the current version of the
+Map, while each put or remove publishes a new version. The old versions, and the values
+that were replaced or removed, are freed once every reader has declared that it no longer
+uses them, so every lookup is made through the online reader of the calling thread. */
+typedef struct read_mostly_map_t *ReadMostlyMap;
+// A thread that reads a Read Mostly Map
+typedef struct read_mostly_reader_t *ReadMostlyReader;
+
+/******************** Read Mostly Map operations declarations ********************/
+
+/* Returns an instance of an empty Read Mostly Map.
+
+PRE:
+- `value_destroy` works like the one given to `map_create`, but the values are destroyed
+once no reader can see them.
+
+POST:
+- if there is not enough memory for the Read Mostly Map, the function will return NULL. */
+ReadMostlyMap read_mostly_map_create(destroy_func_t value_destroy);
+
+/* Frees the memory where the Read Mostly Map is allocated, including every value that was
+not destroyed yet. No other thread may be using it and every reader must be destroyed. */
+void read_mostly_map_destroy(ReadMostlyMap map);
+
+/* Returns the amount of pairs stored in the current version of the Read Mostly Map. It does
+not read the version itself, so it does not need a reader. */
+size_t read_mostly_map_size(ReadMostlyMap map);
+
+/* Works like `map_put`, publishing a new version of the Read Mostly Map. The writers wait
+for each other, but never for the readers. Each put copies every pair, so it is meant for
+maps that change a few times per minute.
+
+POST:
+- If the key was already stored, its old value is destroyed once no reader can see it.
+- Returns true if the action was successful, false if not. */
+bool read_mostly_map_put(ReadMostlyMap map, char *key, void *value);
+
+/* Works like `map_contains` over the Read Mostly Map of the reader, without taking any lock.
+
+PRE:
+- `reader` was created by the calling thread and is online. The version it searches can only
+be freed once the reader declares a quiescent state, so a thread that searches the map
+without an online reader may read a freed version.
+
+POST:
+- If the reader is offline, returns false. */
+bool read_mostly_map_contains(ReadMostlyReader reader, const char *key);
+
+/* Works like `map_get` over the Read Mostly Map of the reader, without taking any lock.
+
+PRE:
+- `reader` was created by the calling thread and is online, like for
+`read_mostly_map_contains`.
+
+POST:
+- The returned value can be used by the calling thread until its reader calls
+`read_mostly_reader_quiescent` or `read_mostly_reader_offline`.
+- If the reader is offline, returns NULL. */
+void *read_mostly_map_get(ReadMostlyReader reader, const char *key);
+
+/* Removes the pair of the given key, publishing a new version of the Read Mostly Map.
+
+POST:
+- The value of the removed pair is destroyed once no reader can see it.
+- Returns true if the key was stored and the pair was removed, false if not. */
+bool read_mostly_map_remove(ReadMostlyMap map, char *key);
+
+/* Works like `map_for_each` over the current version of the Read Mostly Map of the reader,
+without taking any lock. The pairs put or removed while visiting are not seen.
+
+PRE:
+- `reader` was created by the calling thread and is online, like for
+`read_mostly_map_contains`. If it is offline, no pair is visited. */
+void read_mostly_map_for_each(ReadMostlyReader reader, visit_func_t visit, void *extra);
+
+/******************** Read Mostly Reader operations declarations ********************/
+
+/* Registers the calling thread as a reader of the Read Mostly Map. Each thread that reads
+the map needs its own reader, which starts online.
+
+POST:
+- if there is not enough memory for the reader, the function will return NULL. */
+ReadMostlyReader read_mostly_reader_create(ReadMostlyMap map);
+
+/* Unregisters the reader and frees the memory where it is allocated. */
+void read_mostly_reader_destroy(ReadMostlyReader reader);
+
+/* Declares that the thread of the reader does not use any value nor version of the map it
+got before. It must be called often, for example after each request a server handles,
+since nothing retired after its last call can be freed. */
+void read_mostly_reader_quiescent(ReadMostlyReader reader);
+
+/* Declares that the thread of the reader will not read the map for a while, for example
+before it blocks, so the writers do not wait for it to free the retired versions. */
+void read_mostly_reader_offline(ReadMostlyReader reader);
+
+/* Declares that the thread of the reader reads the map again after being offline. */
+void read_mostly_reader_online(ReadMostlyReader reader);
+
+#endif // _READ_MOSTLY_MAP_H
@@ -0,0 +1,458 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "map.h"
+#include "map_hash.h"
+
+#define INITIAL_CAPACITY 16
+#define VARIATION_CAPACITY 2
+// The greatest power of two of a size_t
+#define MAX_CAPACITY (SIZE_MAX / 2 + 1)
+#define MIN_CHARGE_FACTOR 0.15
+#define MAX_CHARGE_FACTOR 0.85
+#define NOT_FOUND SIZE_MAX
+
+#define VALUE_ALIGNMENT 8
+#define BATCH_SIZE 16
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/******************** structure definition ********************/
+
+/* An empty slot has a NULL key. The distance of a taken slot to the index where its key
+was expected (its probe length) is computed from the stored hash. */
+typedef struct pair {
+    char *key;
+    void *value;
+    uint64_t hash;
+    size_t len;
+} pair_t;
+
+/* The capacity is always a power of two, so the index of a hash is `hash & mask`. Each
+pair takes `stride` bytes of the table: a Map created by `map_create_sized` stores
+`value_size` bytes of value right after each pair. The pairs being displaced by an insertion
+are carried in `spare`, which has room for two of them, and `removed` has room for a copy of
+the last removed value. */
+struct hash_t {
+    pair_t *table;
+    size_t capacity;
+    size_t mask;
+    size_t size;
+    size_t value_size;
+    size_t stride;
+    pair_t *spare;
+    void *removed;
+    destroy_func_t destroy;
+    hash_func_t hash_func;
+    uint64_t seed;
+    map_stats_t stats;
+};
+
+/******************** static functions declarations ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount);
+static pair_t *hash_table_create(Map hash, size_t capacity);
+static void hash_table_destroy(Map hash);
+static bool hash_table_resize(Map hash, size_t new_capacity);
+static pair_t *hash_pair(Map hash, pair_t *table, size_t index);
+static void *pair_value(Map hash, pair_t *pair);
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h);
+static size_t hash_insert(Map hash, pair_t *pair);
+static void hash_delete(Map hash, size_t index);
+static size_t hash_distance(Map hash, size_t index);
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found);
+static size_t hash_capacity_for(size_t amount);
+static void next_iter_index(MapIterator iter);
+static char *key_copy(const void *key, size_t len);
+
+// The operations that every implementation defines in the same way
+#include "map_common.h"
+
+/******************** Map operations definitions ********************/
+
+void map_destroy(Map hash) {
+    if (hash == NULL) return;
+
+    hash_table_destroy(hash);
+    free(hash->spare);
+    free(hash->removed);
+    free(hash);
+}
+
+bool map_reserve(Map hash, size_t amount) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(amount);
+    if (new_capacity == 0) return false;
+
+    return new_capacity <= hash->capacity || hash_table_resize(hash, new_capacity);
+}
+
+bool map_shrink_to_fit(Map hash) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(hash->size);
+
+    return new_capacity >= hash->capacity || hash_table_resize(hash, new_capacity);
+}
+
+/* The search for a missing key stops as soon as it reaches a pair that is closer to its
+expected slot, which is usually within the first cache line, so no filter is added. */
+bool map_enable_filter(Map hash) {
+    return hash != NULL;
+}
+
+void **map_entry_n(Map hash, const void *key, size_t len, bool *inserted) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.puts);
+    uint64_t h = hash_key(hash, key, len);
+    size_t index = hash_search(hash, key, len, h);
+
+    if (index != NOT_FOUND) {
+        if (inserted != NULL) *inserted = false;
+        pair_t *pair = hash_pair(hash, hash->table, index);
+        return hash->value_size != 0 ? (void**)pair_value(hash, pair) : &pair->value;
+    }
+
+    // There are no tombstones, so only the stored pairs count for the charge factor
+    float charge_factor = (float)(hash->size + 1) / (float)hash->capacity;
+    if (charge_factor > MAX_CHARGE_FACTOR) if (!hash_table_resize(hash, hash->capacity * VARIATION_CAPACITY)) return NULL;
+
+    pair_t *pair = hash->spare;
+    pair->key = key_copy(key, len);
+    if (pair->key == NULL) return NULL;
+    pair->value = NULL;
+    pair->hash = h;
+    pair->len = len;
+    if (hash->value_size != 0) memset(pair_value(hash, pair), 0, hash->value_size);
+
+    pair = hash_pair(hash, hash->table, hash_insert(hash, pair));
+    hash->size++;
+    if (inserted != NULL) *inserted = true;
+
+    return hash->value_size != 0 ? (void**)pair_value(hash, pair) : &pair->value;
+}
+
+bool map_contains_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return false;
+
+    COUNT(hash->stats.gets);
+    return hash_search(hash, key, len, hash_key(hash, key, len)) != NOT_FOUND;
+}
+
+void *map_get_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.gets);
+    size_t index = hash_search(hash, key, len, hash_key(hash, key, len));
+
+    return index != NOT_FOUND ? pair_value(hash, hash_pair(hash, hash->table, index)) : NULL;
+}
+
+void *map_remove_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.removes);
+    size_t index = hash_search(hash, key, len, hash_key(hash, key, len));
+    if (index == NOT_FOUND) return NULL;
+
+    pair_t *pair = hash_pair(hash, hash->table, index);
+    void *deleted = pair->value;
+    if (hash->value_size != 0) deleted = memcpy(hash->removed, pair_value(hash, pair), hash->value_size);
+    free(pair->key);
+    hash_delete(hash, index);
+    hash->size--;
+
+    float charge_factor = (float)hash->size / (float)hash->capacity;
+    if (charge_factor < MIN_CHARGE_FACTOR && hash->capacity >= INITIAL_CAPACITY * VARIATION_CAPACITY) hash_table_resize(hash, hash->capacity / VARIATION_CAPACITY);
+
+    return deleted;
+}
+
+void map_for_each(Map hash, visit_func_t visit, void *extra) {
+    if (hash == NULL) return;
+
+    pair_t *current;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        current = hash_pair(hash, hash->table, i);
+        if (current->key != NULL && !visit(current->key, pair_value(hash, current), extra)) break;
+    }
+}
+
+void map_stats(Map hash, map_stats_t *stats) {
+    if (hash == NULL || stats == NULL) return;
+
+    // The pairs are shifted back when one is removed, so there are never deleted slots
+    *stats = hash->stats;
+    stats->size = hash->size;
+    stats->capacity = hash->capacity;
+    stats->deleted = 0;
+
+    size_t total_length = 0;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        if (hash_pair(hash, hash->table, i)->key == NULL) continue;
+
+        size_t length = hash_distance(hash, i);
+        stats_add_probe_length(stats, length);
+        total_length += length;
+    }
+    stats->average_probe_length = hash->size > 0 ? (double)total_length / (double)hash->size : 0;
+}
+
+/******************** Map Iterator operations definitions ********************/
+
+bool map_iter_has_next(const MapIterator iter) {
+    return iter != NULL && iter->current_index < iter->hash->capacity;
+}
+
+const char *map_iter_get_current(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_pair(iter->hash, iter->hash->table, iter->current_index)->key : NULL;
+}
+
+void *map_iter_get_value(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? pair_value(iter->hash, hash_pair(iter->hash, iter->hash->table, iter->current_index)) : NULL;
+}
+
+uint64_t map_iter_get_hash(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_pair(iter->hash, iter->hash->table, iter->current_index)->hash : 0;
+}
+
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n) {
+    size_t stored = 0;
+
+    for ( ; stored < n && map_iter_has_next(iter) ; stored++) {
+        pair_t *current = hash_pair(iter->hash, iter->hash->table, iter->current_index);
+        if (keys != NULL) keys[stored] = current->key;
+        if (values != NULL) values[stored] = pair_value(iter->hash, current);
+
+        iter->current_index++;
+        next_iter_index(iter);
+    }
+
+    return stored;
+}
+
+/******************** static functions definitions ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount) {
+    size_t capacity = hash_capacity_for(amount);
+    if (capacity == 0) return NULL;
+
+    Map hash = (Map)malloc(sizeof(struct hash_t));
+    if (hash == NULL) return NULL;
+
+    hash->value_size = value_size;
+    hash->stride = sizeof(pair_t) + (value_size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+    hash->table = hash_table_create(hash, capacity);
+    hash->spare = (pair_t*)malloc(2 * hash->stride);
+    hash->removed = value_size != 0 ? malloc(value_size) : NULL;
+    if (hash->table == NULL || hash->spare == NULL || (value_size != 0 && hash->removed == NULL)) {
+        free(hash->table);
+        free(hash->spare);
+        free(hash->removed);
+        free(hash);
+        return NULL;
+    }
+
+    hash->capacity = capacity;
+    hash->mask = capacity - 1;
+    hash->size = 0;
+    hash->destroy = value_destroy;
+    hash->hash_func = hash_func != NULL ? hash_func : hash_wy;
+    hash->seed = seed;
+    memset(&hash->stats, 0, sizeof(map_stats_t));
+
+    return hash;
+}
+
+static pair_t *hash_table_create(Map hash, size_t capacity) {
+    if (capacity > SIZE_MAX / hash->stride) return NULL;
+
+    pair_t *table = (pair_t*)malloc(capacity * hash->stride);
+    if (table == NULL) return NULL;
+
+    for (size_t i = 0 ; i < capacity ; i++) {
+        pair_t *pair = hash_pair(hash, table, i);
+        pair->key = NULL;
+        pair->value = NULL;
+        pair->hash = 0;
+        pair->len = 0;
+    }
+
+    return table;
+}
+
+static void hash_table_destroy(Map hash) {
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        pair_t *current = hash_pair(hash, hash->table, i);
+        if (current->key == NULL) continue;
+        free(current->key);
+        if (hash->destroy != NULL) (hash->destroy)(pair_value(hash, current));
+    }
+
+    free(hash->table);
+}
+
+static bool hash_table_resize(Map hash, size_t new_capacity) {
+    clock_t start = clock();
+    pair_t *new_table = hash_table_create(hash, new_capacity);
+    if (new_table == NULL) return false;
+
+    pair_t *old_table = hash->table;
+    size_t old_capacity = hash->capacity;
+    hash->table = new_table;
+    hash->capacity = new_capacity;
+    hash->mask = new_capacity - 1;
+
+    // The keys are already owned by the Map and their hashes are stored, so the pairs are just moved
+    for (size_t i = 0 ; i < old_capacity ; i++) {
+        pair_t *current = hash_pair(hash, old_table, i);
+        if (current->key == NULL) continue;
+        memcpy(hash->spare, current, hash->stride);
+        hash_insert(hash, hash->spare);
+    }
+    free(old_table);
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return true;
+}
+
+/* Returns the index of the pair with the given key, or NOT_FOUND. The search stops as soon
+as it reaches a pair that is closer to its expected index than the key would be at that
+point, because the insertion would have placed the key before it. */
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h) {
+    size_t index = (size_t)h & hash->mask;
+
+    for (size_t distance = 0 ; hash_pair(hash, hash->table, index)->key != NULL ; distance++) {
+        COUNT(hash->stats.probes);
+        if (hash_distance(hash, index) < distance) break;
+        pair_t *current = hash_pair(hash, hash->table, index);
+        if (current->hash == h && current->len == len && memcmp(current->key, key, len) == 0) return index;
+        index = (index + 1) & hash->mask;
+    }
+
+    return NOT_FOUND;
+}
+
+/* Inserts a pair whose key is not stored in the Map. Whenever the pair being placed is
+further from its expected index than the one in the current slot, they are swapped and the
+displaced pair continues the probing. The table must have at least one empty slot. The
+given pair must be the first one of `spare`, as the second one is used for the swaps.
+Returns the index where the given pair is stored; the pairs it displaces move further. */
+static size_t hash_insert(Map hash, pair_t *pair) {
+    pair_t *swap = hash_pair(hash, hash->spare, 1);
+    size_t index = (size_t)pair->hash & hash->mask;
+    size_t inserted = SIZE_MAX;
+
+    for (size_t distance = 0 ; hash_pair(hash, hash->table, index)->key != NULL ; distance++) {
+        size_t current_distance = hash_distance(hash, index);
+        if (current_distance < distance) {
+            pair_t *current = hash_pair(hash, hash->table, index);
+            memcpy(swap, current, hash->stride);
+            memcpy(current, pair, hash->stride);
+            memcpy(pair, swap, hash->stride);
+            distance = current_distance;
+            if (inserted == SIZE_MAX) inserted = index;
+        }
+        index = (index + 1) & hash->mask;
+    }
+
+    memcpy(hash_pair(hash, hash->table, index), pair, hash->stride);
+
+    return inserted != SIZE_MAX ? inserted : index;
+}
+
+/* Empties the slot at the given index by shifting back the pairs that follow it until an
+empty slot or a pair at its expected index is found, so no tombstones are needed. */
+static void hash_delete(Map hash, size_t index) {
+    size_t next = (index + 1) & hash->mask;
+
+    while (hash_pair(hash, hash->table, next)->key != NULL && hash_distance(hash, next) > 0) {
+        memcpy(hash_pair(hash, hash->table, index), hash_pair(hash, hash->table, next), hash->stride);
+        index = next;
+        next = (next + 1) & hash->mask;
+    }
+
+    hash_pair(hash, hash->table, index)->key = NULL;
+    hash_pair(hash, hash->table, index)->value = NULL;
+}
+
+static pair_t *hash_pair(Map hash, pair_t *table, size_t index) {
+    return (pair_t*)((char*)table + index * hash->stride);
+}
+
+// Returns the value of the pair, or the address of its bytes if the Map stores them
+static void *pair_value(Map hash, pair_t *pair) {
+    return hash->value_size != 0 ? (void*)(pair + 1) : pair->value;
+}
+
+// Returns how far the pair at the given index is from its expected index
+static size_t hash_distance(Map hash, size_t index) {
+    return (index - ((size_t)hash_pair(hash, hash->table, index)->hash & hash->mask)) & hash->mask;
+}
+
+/* Searches the keys in batches of BATCH_SIZE: first every key of the batch is hashed and the
+memory of its expected slot is prefetched, and then they are searched. Either `values` or
+`found` can be NULL. */
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found) {
+    if (hash == NULL) return 0;
+
+    uint64_t hashes[BATCH_SIZE];
+    size_t lens[BATCH_SIZE];
+    size_t stored = 0;
+
+    for (size_t start = 0 ; start < n ; start += BATCH_SIZE) {
+        size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            lens[i] = strlen(keys[start + i]);
+            hashes[i] = hash_key(hash, keys[start + i], lens[i]);
+            PREFETCH(hash_pair(hash, hash->table, (size_t)hashes[i] & hash->mask));
+        }
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            size_t index = hash_search(hash, keys[start + i], lens[i], hashes[i]);
+            COUNT(hash->stats.gets);
+            bool is_stored = index != NOT_FOUND;
+            void *value = is_stored ? pair_value(hash, hash_pair(hash, hash->table, index)) : NULL;
+            if (values != NULL) values[start + i] = value;
+            if (found != NULL) found[start + i] = is_stored;
+            if (is_stored) stored++;
+        }
+    }
+
+    return stored;
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t hash_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_CAPACITY;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
+static void next_iter_index(MapIterator iter) {
+    while (map_iter_has_next(iter) && hash_pair(iter->hash, iter->hash->table, iter->current_index)->key == NULL) iter->current_index++;
+}
+
+// Returns a copy of the key followed by a '\0'
+static char *key_copy(const void *key, size_t len) {
+    char *copy = (char*)malloc((len+1) * sizeof(char));
+    if (copy == NULL) return NULL;
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+
+    return copy;
+}
@@ -0,0 +1,518 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "map.h"
+#include "map_hash.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16
+#define INITIAL_CAPACITY 16
+#define VARIATION_CAPACITY 2
+// The greatest power of two of a size_t
+#define MAX_CAPACITY (SIZE_MAX / 2 + 1)
+#define MIN_CHARGE_FACTOR 0.15
+#define MAX_CHARGE_FACTOR 0.875
+#define NOT_FOUND SIZE_MAX
+
+#define VALUE_ALIGNMENT 8
+#define BATCH_SIZE 16
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/******************** structure definition ********************/
+
+/* Every slot of the table has a control byte in a separate array. A taken slot stores the
+lower 7 bits of the hash of its key (so its high bit is 0), while the empty and deleted
+slots are marked with negative values. */
+typedef int8_t ctrl_t;
+
+#define EMPTY ((ctrl_t)-128)
+#define DELETED ((ctrl_t)-2)
+
+// The full hash of the key is stored too, so resizing the table does not read any key
+typedef struct slot {
+    char *key;
+    void *value;
+    uint64_t hash;
+    size_t len;
+} slot_t;
+
+/* Each slot takes `stride` bytes: a Map created by `map_create_sized` stores `value_size`
+bytes of value right after each slot, and `removed` has room for a copy of the last removed
+value. */
+struct hash_t {
+    ctrl_t *ctrl;
+    slot_t *slots;
+    size_t capacity;
+    size_t size;
+    size_t deleted;
+    size_t value_size;
+    size_t stride;
+    void *removed;
+    destroy_func_t destroy;
+    hash_func_t hash_func;
+    uint64_t seed;
+    map_stats_t stats;
+};
+
+/******************** static functions declarations ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount);
+static bool hash_table_create(Map hash, size_t capacity);
+static void hash_table_destroy(Map hash);
+static bool hash_table_resize(Map hash, size_t new_capacity);
+static slot_t *hash_slot(Map hash, slot_t *slots, size_t index);
+static void *slot_value(Map hash, slot_t *slot);
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h);
+static size_t hash_find_free_slot(Map hash, uint64_t h);
+static size_t hash_probe_length(Map hash, uint64_t h, size_t index);
+static uint32_t group_match(const ctrl_t *group, ctrl_t tag);
+static uint32_t group_match_free(const ctrl_t *group);
+static unsigned lowest_bit(uint32_t mask);
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found);
+static size_t hash_capacity_for(size_t amount);
+static void next_iter_index(MapIterator iter);
+static char *key_copy(const void *key, size_t len);
+
+// The operations that every implementation defines in the same way
+#include "map_common.h"
+
+/******************** Map operations definitions ********************/
+
+void map_destroy(Map hash) {
+    if (hash == NULL) return;
+
+    hash_table_destroy(hash);
+    free(hash->removed);
+    free(hash);
+}
+
+bool map_reserve(Map hash, size_t amount) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(amount);
+    if (new_capacity == 0) return false;
+
+    return new_capacity <= hash->capacity || hash_table_resize(hash, new_capacity);
+}
+
+bool map_shrink_to_fit(Map hash) {
+    if (hash == NULL) return false;
+
+    size_t new_capacity = hash_capacity_for(hash->size);
+
+    return new_capacity >= hash->capacity || hash_table_resize(hash, new_capacity);
+}
+
+// The tags of a group already tell most missing keys apart reading a single cache line
+bool map_enable_filter(Map hash) {
+    return hash != NULL;
+}
+
+void **map_entry_n(Map hash, const void *key, size_t len, bool *inserted) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.puts);
+    uint64_t h = hash_key(hash, key, len);
+    size_t index = hash_search(hash, key, len, h);
+
+    if (index != NOT_FOUND) {
+        if (inserted != NULL) *inserted = false;
+        slot_t *slot = hash_slot(hash, hash->slots, index);
+        return hash->value_size != 0 ? (void**)slot_value(hash, slot) : &slot->value;
+    }
+
+    float charge_factor = (float)(hash->size + hash->deleted + 1) / (float)hash->capacity;
+    if (charge_factor > MAX_CHARGE_FACTOR) {
+        // When most of the load are deleted slots, the table is rebuilt with the same capacity
+        size_t new_capacity = (float)(hash->size + 1) / (float)hash->capacity > MAX_CHARGE_FACTOR / VARIATION_CAPACITY ? hash->capacity * VARIATION_CAPACITY : hash->capacity;
+        if (!hash_table_resize(hash, new_capacity)) return NULL;
+    }
+
+    char *copy = key_copy(key, len);
+    if (copy == NULL) return NULL;
+
+    index = hash_find_free_slot(hash, h);
+    if (hash->ctrl[index] == DELETED) hash->deleted--;
+    hash->ctrl[index] = (ctrl_t)(h & 0x7F);
+    slot_t *slot = hash_slot(hash, hash->slots, index);
+    slot->key = copy;
+    slot->value = NULL;
+    slot->hash = h;
+    slot->len = len;
+    hash->size++;
+    if (inserted != NULL) *inserted = true;
+
+    if (hash->value_size == 0) return &slot->value;
+    memset(slot_value(hash, slot), 0, hash->value_size);
+
+    return (void**)slot_value(hash, slot);
+}
+
+bool map_contains_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return false;
+
+    COUNT(hash->stats.gets);
+    return hash_search(hash, key, len, hash_key(hash, key, len)) != NOT_FOUND;
+}
+
+void *map_get_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.gets);
+    size_t index = hash_search(hash, key, len, hash_key(hash, key, len));
+
+    return index != NOT_FOUND ? slot_value(hash, hash_slot(hash, hash->slots, index)) : NULL;
+}
+
+void *map_remove_n(Map hash, const void *key, size_t len) {
+    if (hash == NULL) return NULL;
+
+    COUNT(hash->stats.removes);
+    size_t index = hash_search(hash, key, len, hash_key(hash, key, len));
+    if (index == NOT_FOUND) return NULL;
+
+    slot_t *slot = hash_slot(hash, hash->slots, index);
+    void *deleted = slot->value;
+    if (hash->value_size != 0) deleted = memcpy(hash->removed, slot_value(hash, slot), hash->value_size);
+    free(slot->key);
+    slot->key = NULL;
+    slot->value = NULL;
+    hash->size--;
+
+    /* If the group still has an empty slot, no probe sequence has ever gone through it, so
+    the slot can be marked as empty instead of leaving a tombstone. */
+    ctrl_t *group = hash->ctrl + (index - index % GROUP_WIDTH);
+    if (group_match(group, EMPTY) != 0) {
+        hash->ctrl[index] = EMPTY;
+    } else {
+        hash->ctrl[index] = DELETED;
+        hash->deleted++;
+    }
+
+    float charge_factor = (float)hash->size / (float)hash->capacity;
+    if (charge_factor < MIN_CHARGE_FACTOR && hash->capacity >= INITIAL_CAPACITY * VARIATION_CAPACITY) hash_table_resize(hash, hash->capacity / VARIATION_CAPACITY);
+
+    return deleted;
+}
+
+void map_for_each(Map hash, visit_func_t visit, void *extra) {
+    if (hash == NULL) return;
+
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        if (hash->ctrl[i] < 0) continue;
+        slot_t *slot = hash_slot(hash, hash->slots, i);
+        if (!visit(slot->key, slot_value(hash, slot), extra)) break;
+    }
+}
+
+void map_stats(Map hash, map_stats_t *stats) {
+    if (hash == NULL || stats == NULL) return;
+
+    *stats = hash->stats;
+    stats->size = hash->size;
+    stats->capacity = hash->capacity;
+    stats->deleted = hash->deleted;
+
+    size_t total_length = 0;
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        if (hash->ctrl[i] < 0) continue;
+
+        size_t length = hash_probe_length(hash, hash_slot(hash, hash->slots, i)->hash, i);
+        stats_add_probe_length(stats, length);
+        total_length += length;
+    }
+    stats->average_probe_length = hash->size > 0 ? (double)total_length / (double)hash->size : 0;
+}
+
+/******************** Map Iterator operations definitions ********************/
+
+bool map_iter_has_next(const MapIterator iter) {
+    return iter != NULL && iter->current_index < iter->hash->capacity;
+}
+
+const char *map_iter_get_current(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_slot(iter->hash, iter->hash->slots, iter->current_index)->key : NULL;
+}
+
+void *map_iter_get_value(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? slot_value(iter->hash, hash_slot(iter->hash, iter->hash->slots, iter->current_index)) : NULL;
+}
+
+uint64_t map_iter_get_hash(const MapIterator iter) {
+    return iter != NULL && map_iter_has_next(iter) ? hash_slot(iter->hash, iter->hash->slots, iter->current_index)->hash : 0;
+}
+
+size_t map_iter_next_batch(MapIterator iter, const char **keys, void **values, size_t n) {
+    size_t stored = 0;
+
+    for ( ; stored < n && map_iter_has_next(iter) ; stored++) {
+        slot_t *current = hash_slot(iter->hash, iter->hash->slots, iter->current_index);
+        if (keys != NULL) keys[stored] = current->key;
+        if (values != NULL) values[stored] = slot_value(iter->hash, current);
+
+        iter->current_index++;
+        next_iter_index(iter);
+    }
+
+    return stored;
+}
+
+/******************** static functions definitions ********************/
+
+static Map hash_create(destroy_func_t value_destroy, hash_func_t hash_func, uint64_t seed, size_t value_size, size_t amount) {
+    size_t capacity = hash_capacity_for(amount);
+    if (capacity == 0) return NULL;
+
+    Map hash = (Map)malloc(sizeof(struct hash_t));
+    if (hash == NULL) return NULL;
+
+    hash->value_size = value_size;
+    hash->stride = sizeof(slot_t) + (value_size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+    hash->removed = value_size != 0 ? malloc(value_size) : NULL;
+    if ((value_size != 0 && hash->removed == NULL) || !hash_table_create(hash, capacity)) {
+        free(hash->removed);
+        free(hash);
+        return NULL;
+    }
+
+    hash->size = 0;
+    hash->deleted = 0;
+    hash->destroy = value_destroy;
+    hash->hash_func = hash_func != NULL ? hash_func : hash_wy;
+    hash->seed = seed;
+    memset(&hash->stats, 0, sizeof(map_stats_t));
+
+    return hash;
+}
+
+static bool hash_table_create(Map hash, size_t capacity) {
+    if (capacity > SIZE_MAX / hash->stride) return false;
+
+    ctrl_t *ctrl = (ctrl_t*)malloc(capacity * sizeof(ctrl_t));
+    if (ctrl == NULL) return false;
+
+    slot_t *slots = (slot_t*)malloc(capacity * hash->stride);
+    if (slots == NULL) {
+        free(ctrl);
+        return false;
+    }
+
+    memset(ctrl, EMPTY, capacity * sizeof(ctrl_t));
+
+    hash->ctrl = ctrl;
+    hash->slots = slots;
+    hash->capacity = capacity;
+
+    return true;
+}
+
+static void hash_table_destroy(Map hash) {
+    for (size_t i = 0 ; i < hash->capacity ; i++) {
+        if (hash->ctrl[i] < 0) continue;
+        slot_t *slot = hash_slot(hash, hash->slots, i);
+        free(slot->key);
+        if (hash->destroy != NULL) (hash->destroy)(slot_value(hash, slot));
+    }
+
+    free(hash->ctrl);
+    free(hash->slots);
+}
+
+static bool hash_table_resize(Map hash, size_t new_capacity) {
+    clock_t start = clock();
+    ctrl_t *old_ctrl = hash->ctrl;
+    slot_t *old_slots = hash->slots;
+    size_t old_capacity = hash->capacity;
+
+    if (!hash_table_create(hash, new_capacity)) return false;
+    hash->deleted = 0;
+
+    // The pairs are moved with their stored hash, the keys are neither copied nor hashed again
+    for (size_t i = 0 ; i < old_capacity ; i++) {
+        if (old_ctrl[i] < 0) continue;
+        slot_t *slot = hash_slot(hash, old_slots, i);
+        size_t index = hash_find_free_slot(hash, slot->hash);
+        hash->ctrl[index] = old_ctrl[i];
+        memcpy(hash_slot(hash, hash->slots, index), slot, hash->stride);
+    }
+
+    free(old_ctrl);
+    free(old_slots);
+
+    hash->stats.resizes++;
+    hash->stats.resize_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    return true;
+}
+
+/* Returns the index of the slot that stores the key, or NOT_FOUND. The groups of the probe
+sequence are visited until one of them has an empty slot, and only the slots whose control
+byte matches the lower bits of the hash have their keys compared. */
+static size_t hash_search(Map hash, const void *key, size_t len, uint64_t h) {
+    size_t groups_mask = hash->capacity / GROUP_WIDTH - 1;
+    size_t group = (size_t)(h >> 7) & groups_mask;
+    ctrl_t tag = (ctrl_t)(h & 0x7F);
+
+    for (size_t step = 1 ; step <= groups_mask + 1 ; step++) {
+        const ctrl_t *ctrl = hash->ctrl + group * GROUP_WIDTH;
+        COUNT(hash->stats.probes);
+
+        for (uint32_t match = group_match(ctrl, tag) ; match != 0 ; match &= match - 1) {
+            size_t index = group * GROUP_WIDTH + lowest_bit(match);
+            slot_t *slot = hash_slot(hash, hash->slots, index);
+            if (slot->hash == h && slot->len == len && memcmp(slot->key, key, len) == 0) return index;
+        }
+        if (group_match(ctrl, EMPTY) != 0) return NOT_FOUND;
+
+        group = (group + step) & groups_mask;
+    }
+
+    return NOT_FOUND;
+}
+
+static slot_t *hash_slot(Map hash, slot_t *slots, size_t index) {
+    return (slot_t*)((char*)slots + index * hash->stride);
+}
+
+// Returns the value of the slot, or the address of its bytes if the Map stores them
+static void *slot_value(Map hash, slot_t *slot) {
+    return hash->value_size != 0 ? (void*)(slot + 1) : slot->value;
+}
+
+/* Returns the index of the first empty or deleted slot in the probe sequence of the hash.
+The table must have at least one free slot. */
+static size_t hash_find_free_slot(Map hash, uint64_t h) {
+    size_t groups_mask = hash->capacity / GROUP_WIDTH - 1;
+    size_t group = (size_t)(h >> 7) & groups_mask;
+
+    for (size_t step = 1 ; ; step++) {
+        uint32_t match = group_match_free(hash->ctrl + group * GROUP_WIDTH);
+        if (match != 0) return group * GROUP_WIDTH + lowest_bit(match);
+
+        group = (group + step) & groups_mask;
+    }
+}
+
+// Returns how many groups the probe sequence of the hash goes through before the group of the slot
+static size_t hash_probe_length(Map hash, uint64_t h, size_t index) {
+    size_t groups_mask = hash->capacity / GROUP_WIDTH - 1;
+    size_t group = (size_t)(h >> 7) & groups_mask, length = 0;
+
+    for (size_t step = 1 ; group != index / GROUP_WIDTH ; step++, length++) group = (group + step) & groups_mask;
+
+    return length;
+}
+
+#ifdef __SSE2__
+
+static uint32_t group_match(const ctrl_t *group, ctrl_t tag) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+}
+
+static uint32_t group_match_free(const ctrl_t *group) {
+    // Both EMPTY and DELETED are the only control bytes with the high bit set
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+
+#else
+
+static uint32_t group_match(const ctrl_t *group, ctrl_t tag) {
+    uint32_t mask = 0;
+    for (unsigned i = 0 ; i < GROUP_WIDTH ; i++) if (group[i] == tag) mask |= 1u << i;
+
+    return mask;
+}
+
+static uint32_t group_match_free(const ctrl_t *group) {
+    uint32_t mask = 0;
+    for (unsigned i = 0 ; i < GROUP_WIDTH ; i++) if (group[i] < 0) mask |= 1u << i;
+
+    return mask;
+}
+
+#endif
+
+static unsigned lowest_bit(uint32_t mask) {
+#ifdef __GNUC__
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned bit = 0;
+    while ((mask & 1u) == 0) {
+        mask >>= 1;
+        bit++;
+    }
+
+    return bit;
+#endif
+}
+
+/* Searches the keys in batches of BATCH_SIZE: first every key of the batch is hashed and the
+memory of its expected slot is prefetched, and then they are searched. Either `values` or
+`found` can be NULL. */
+static size_t hash_search_many(Map hash, const char **keys, size_t n, void **values, bool *found) {
+    if (hash == NULL) return 0;
+
+    uint64_t hashes[BATCH_SIZE];
+    size_t lens[BATCH_SIZE];
+    size_t stored = 0;
+
+    for (size_t start = 0 ; start < n ; start += BATCH_SIZE) {
+        size_t batch = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            lens[i] = strlen(keys[start + i]);
+            hashes[i] = hash_key(hash, keys[start + i], lens[i]);
+            size_t group = (size_t)(hashes[i] >> 7) & (hash->capacity / GROUP_WIDTH - 1);
+            PREFETCH(hash->ctrl + group * GROUP_WIDTH);
+            PREFETCH(hash_slot(hash, hash->slots, group * GROUP_WIDTH));
+        }
+
+        for (size_t i = 0 ; i < batch ; i++) {
+            size_t index = hash_search(hash, keys[start + i], lens[i], hashes[i]);
+            COUNT(hash->stats.gets);
+            bool is_stored = index != NOT_FOUND;
+            void *value = is_stored ? slot_value(hash, hash_slot(hash, hash->slots, index)) : NULL;
+            if (values != NULL) values[start + i] = value;
+            if (found != NULL) found[start + i] = is_stored;
+            if (is_stored) stored++;
+        }
+    }
+
+    return stored;
+}
+
+/* Returns the least capacity that can store the given amount of pairs without being resized,
+or 0 if it would be greater than MAX_CAPACITY. */
+static size_t hash_capacity_for(size_t amount) {
+    if ((float)amount > (float)MAX_CAPACITY * MAX_CHARGE_FACTOR) return 0;
+
+    size_t capacity = INITIAL_CAPACITY;
+    while ((float)amount / (float)capacity > MAX_CHARGE_FACTOR) capacity *= VARIATION_CAPACITY;
+
+    return capacity;
+}
+
+static void next_iter_index(MapIterator iter) {
+    while (map_iter_has_next(iter) && iter->hash->ctrl[iter->current_index] < 0) iter->current_index++;
+}
+
+// Returns a copy of the key followed by a '\0'
+static char *key_copy(const void *key, size_t len) {
+    char *copy = (char*)malloc((len+1) * sizeof(char));
+    if (copy == NULL) return NULL;
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+
+    return copy;
+}
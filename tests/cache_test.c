@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../map/cache.h"
+#include "assert_msg.h"
+
+static void print_test(bool, const char*);
+static void count_destroy(void *value);
+static bool count_pairs(const char *key, void *value, void *extra);
+
+static size_t destroyed = 0;
+
+static void test_new_cache(void) {
+    printf("TEST: A newly created cache works as expected.\n");
+
+    Cache c = cache_create(AMOUNT, CACHE_LRU, NULL);
+    cache_stats_t stats;
+
+    print_test(c != NULL, "Create a new cache");
+    print_test(cache_size(c) == 0, "A newly created cache must be empty");
+    print_test(cache_get(c, "key") == NULL && !cache_contains(c, "key"), "An empty cache does not contain any key");
+    print_test(cache_remove(c, "key") == NULL, "An empty cache returns NULL, for any key, if it tries to remove");
+
+    cache_stats(c, &stats);
+    print_test(stats.hits == 0 && stats.misses == 1 && stats.capacity == AMOUNT, "The get of a missing key is counted as a miss");
+    print_test(cache_create(0, CACHE_CLOCK, NULL) == NULL, "A cache can not be created without capacity");
+
+    cache_destroy(c);
+}
+
+static void test_lru_eviction(void) {
+    printf("TEST: A full LRU cache evicts its least recently used pair\n");
+
+    Cache c = cache_create(3, CACHE_LRU, count_destroy);
+    destroyed = 0;
+
+    bool ok = cache_put(c, "a", "1") && cache_put(c, "b", "2") && cache_put(c, "c", "3");
+    print_test(ok && cache_size(c) == 3 && destroyed == 0, "The cache is filled without evicting any pair");
+
+    print_test(strcmp((char*)cache_get(c, "a"), "1") == 0, "The oldest pair is used");
+    print_test(cache_put(c, "d", "4") && destroyed == 1, "Putting a new pair evicts another one");
+    print_test(!cache_contains(c, "b") && cache_contains(c, "a") && cache_contains(c, "c") && cache_contains(c, "d"), "The least recently used pair is the one evicted");
+
+    print_test(cache_put(c, "c", "5") && destroyed == 2 && cache_size(c) == 3, "Updating a pair destroys its old value without evicting");
+    print_test(cache_put(c, "e", "6") && !cache_contains(c, "a"), "An updated pair counts as used");
+    print_test(strcmp((char*)cache_get(c, "c"), "5") == 0, "The updated pair has its new value");
+
+    cache_stats_t stats;
+    cache_stats(c, &stats);
+    print_test(stats.size == 3 && stats.charge == 3 && stats.evictions == 2 && stats.hits == 2 && stats.misses == 0, "The stats count the hits and the evictions");
+
+    cache_destroy(c);
+    print_test(destroyed == 6, "The values left are destroyed with the cache");
+}
+
+static void test_clock_eviction(void) {
+    printf("TEST: A full CLOCK cache evicts a pair that was not used\n");
+
+    Cache c = cache_create(3, CACHE_CLOCK, count_destroy);
+    destroyed = 0;
+
+    bool ok = cache_put(c, "a", "1") && cache_put(c, "b", "2") && cache_put(c, "c", "3");
+    ok = ok && cache_get(c, "a") != NULL && cache_get(c, "b") != NULL;
+    print_test(ok && cache_put(c, "d", "4") && destroyed == 1, "Putting a new pair evicts another one");
+    print_test(!cache_contains(c, "c") && cache_contains(c, "a") && cache_contains(c, "b") && cache_contains(c, "d"), "The pair that was not used is the one evicted");
+
+    print_test(cache_put(c, "e", "5") && cache_put(c, "f", "6") && cache_contains(c, "f") && cache_size(c) == 3, "The pair that is put is never evicted");
+
+    cache_destroy(c);
+    print_test(destroyed == 6, "The values left are destroyed with the cache");
+}
+
+static void test_charged_pairs(void) {
+    printf("TEST: A cache limited in bytes evicts pairs until the new one fits\n");
+
+    Cache c = cache_create(100, CACHE_LRU, NULL);
+    cache_stats_t stats;
+
+    bool ok = cache_put_charged(c, "small", "1", 10) && cache_put_charged(c, "medium", "2", 40) && cache_put_charged(c, "large", "3", 50);
+    cache_stats(c, &stats);
+    print_test(ok && stats.size == 3 && stats.charge == 100, "The pairs are stored while their charges fit");
+
+    print_test(cache_put_charged(c, "huge", "4", 50) && !cache_contains(c, "small") && !cache_contains(c, "medium") && cache_contains(c, "large"), "The oldest pairs are evicted until the new one fits");
+    print_test(!cache_put_charged(c, "too big", "5", 101) && cache_size(c) == 2, "A pair with a charge greater than the capacity is not put");
+
+    print_test(cache_put_charged(c, "large", "6", 5), "The charge of a pair is updated with its value");
+    cache_stats(c, &stats);
+    print_test(stats.charge == 55 && stats.evictions == 2, "The charge of the cache follows the updated pair");
+
+    print_test(strcmp((char*)cache_remove(c, "huge"), "4") == 0 && cache_size(c) == 1, "A removed pair gives back its value");
+    cache_stats(c, &stats);
+    print_test(stats.charge == 5, "A removed pair gives back its charge");
+
+    cache_destroy(c);
+}
+
+static void test_many_pairs(void) {
+    printf("TEST: Put many more pairs than fit in the cache\n");
+
+    Cache c = cache_create(BULK_AMOUNT / 2, CACHE_LRU, free);
+    char current_key[40];
+    bool ok = true;
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        int *value = (int*)malloc(sizeof(int));
+        print_test(value != NULL, "");
+        *value = i;
+        // Some of the keys are too long to be stored inside the table
+        sprintf(current_key, i % 3 == 0 ? "%d" : "a long key for the pair %d", i);
+        ok = cache_put(c, current_key, value);
+    }
+    print_test(ok && cache_size(c) == BULK_AMOUNT / 2, "The cache keeps the amount of pairs it has room for");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, i % 3 == 0 ? "%d" : "a long key for the pair %d", i);
+        int *value = (int*)cache_get(c, current_key);
+        ok = i < BULK_AMOUNT / 2 ? value == NULL : value != NULL && *value == i;
+    }
+    print_test(ok, "Only the newest pairs are stored");
+
+    size_t counter = 0;
+    cache_for_each(c, count_pairs, &counter);
+    print_test(counter == BULK_AMOUNT / 2, "The internal iterator visits every pair");
+
+    for (int i = BULK_AMOUNT / 2 ; i < BULK_AMOUNT && ok ; i += 2) {
+        sprintf(current_key, i % 3 == 0 ? "%d" : "a long key for the pair %d", i);
+        int *value = (int*)cache_remove(c, current_key);
+        ok = value != NULL && *value == i && !cache_contains(c, current_key);
+        free(value);
+    }
+    for (int i = BULK_AMOUNT / 2 + 1 ; i < BULK_AMOUNT && ok ; i += 2) {
+        sprintf(current_key, i % 3 == 0 ? "%d" : "a long key for the pair %d", i);
+        ok = cache_contains(c, current_key);
+    }
+    print_test(ok && cache_size(c) == BULK_AMOUNT / 4, "The removed pairs are not found and the others still are");
+
+    cache_stats_t stats;
+    cache_stats(c, &stats);
+    print_test(stats.hits == BULK_AMOUNT / 2 && stats.misses == BULK_AMOUNT / 2 && stats.evictions == BULK_AMOUNT / 2, "Every get and eviction is counted");
+
+    cache_destroy(c);
+}
+
+int main(void) {
+    test_new_cache();
+    test_lru_eviction();
+    test_clock_eviction();
+    test_charged_pairs();
+    test_many_pairs();
+
+    return 0;
+}
+
+void print_test(bool success, const char* msg) {
+    char result[10 + (int)strlen(msg)];
+    sprintf(result, "FAIL: %s\n", msg);
+    assert_msg(success, result);
+}
+
+void count_destroy(void *value) {
+    destroyed++;
+}
+
+bool count_pairs(const char *key, void *value, void *extra) {
+    *(size_t*)extra += 1;
+    return true;
+}
@@ -0,0 +1,274 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../map/concurrent_map.h"
+#include "assert_msg.h"
+
+#define THREADS 8
+
+typedef struct {
+    ConcurrentMap map;
+    int thread;
+    bool ok;
+} ThreadArgs;
+
+static void print_test(bool, const char*);
+static void *put_keys(void *args);
+static void *get_and_remove_keys(void *args);
+static void *build_keys(void *args);
+static bool count_pairs_atomically(const char *key, void *value, void *extra);
+static bool sum_values_atomically(const char *key, void *value, void *extra);
+static bool stop_after_first(const char *key, void *value, void *extra);
+static void *build_keys(void *args) {
+    ThreadArgs* thread_args = (ThreadArgs*)args;
+    ConcurrentMapBuilder builder = concurrent_map_builder_create(thread_args->map);
+    char current_key[20];
+
+    thread_args->ok = builder != NULL;
+    for (int i = 0 ; i < BULK_AMOUNT && thread_args->ok ; i++) {
+        sprintf(current_key, "%d-%d", thread_args->thread, i);
+        int* value = (int*)malloc(sizeof(int));
+        if (value == NULL) {
+            thread_args->ok = false;
+            break;
+        }
+        *value = i;
+        thread_args->ok = concurrent_map_builder_put(builder, current_key, value);
+    }
+    thread_args->ok = thread_args->ok && concurrent_map_builder_flush(builder);
+    concurrent_map_builder_destroy(builder);
+
+    return NULL;
+}
+
+bool count_pairs_atomically(const char *key, void *value, void *extra) {
+    __atomic_fetch_add((size_t*)extra, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool sum_values_atomically(const char *key, void *value, void *extra) {
+    __atomic_fetch_add((long*)extra, *(int*)value, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool stop_after_first(const char *key, void *value, void *extra) {
+    __atomic_fetch_add((size_t*)extra, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+bool count_pairs(const char *key, void *value, void *extra);
+static bool stop_at_first(const char *key, void *value, void *extra);
+
+static void test_new_concurrent_map(void) {
+    printf("TEST: A newly created concurrent map works as expected.\n");
+
+    ConcurrentMap m = concurrent_map_create(NULL, 0);
+
+    print_test(m != NULL, "Create a new concurrent map");
+    print_test(concurrent_map_size(m) == 0, "A newly created concurrent map must be empty");
+    print_test(concurrent_map_get(m, "key") == NULL, "An empty concurrent map returns NULL, for any key, if it tries to get a value");
+    print_test(concurrent_map_remove(m, "key") == NULL, "An empty concurrent map returns NULL, for any key, if it tries to remove");
+    print_test(!concurrent_map_contains(m, "key"), "An empty concurrent map does not contain any key");
+
+    concurrent_map_destroy(m);
+}
+
+static void test_concurrent_map_one_thread(void) {
+    printf("TEST: Put, get, update and remove pairs from a single thread\n");
+
+    ConcurrentMap m = concurrent_map_create(free, 3);
+    char current_key[10];
+    bool ok = true;
+
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        int* value = (int*)malloc(sizeof(int));
+        print_test(value != NULL, "");
+        *value = i;
+        ok = concurrent_map_put(m, current_key, value);
+    }
+    print_test(ok, "The pairs are stored correctly");
+    print_test(concurrent_map_size(m) == AMOUNT, "The amount of stored pairs is correct");
+
+    int* updated = (int*)malloc(sizeof(int));
+    print_test(updated != NULL, "");
+    *updated = -1;
+    print_test(concurrent_map_put(m, "0", updated), "The value of a pair is updated correctly");
+    print_test(concurrent_map_size(m) == AMOUNT, "The size does not change after updating a pair");
+
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        int* ptr = (int*)concurrent_map_get(m, current_key);
+        ok = ptr != NULL && *ptr == (i == 0 ? -1 : i);
+    }
+    print_test(ok, "Every key has the correct value");
+
+    size_t counter = 0;
+    concurrent_map_for_each(m, count_pairs, &counter);
+    print_test(counter == AMOUNT, "The internal iterator visits every pair");
+
+    counter = 0;
+    concurrent_map_for_each(m, stop_at_first, &counter);
+    print_test(counter == 1, "The internal iterator stops when the visit function returns false");
+
+    int* ptr = (int*)concurrent_map_remove(m, "1");
+    print_test(ptr != NULL && *ptr == 1, "The pair is removed correctly");
+    free(ptr);
+    print_test(!concurrent_map_contains(m, "1"), "The removed key is not contained in the concurrent map");
+    print_test(concurrent_map_size(m) == AMOUNT - 1, "The size goes down by one after removing a pair");
+
+    concurrent_map_destroy(m);
+}
+
+static void test_concurrent_map_many_threads(void) {
+    printf("TEST: Many threads put, get and remove their own keys at the same time\n");
+
+    ConcurrentMap m = concurrent_map_create(free, 0);
+    pthread_t threads[THREADS];
+    ThreadArgs args[THREADS];
+    bool ok = true;
+
+    for (int i = 0 ; i < THREADS ; i++) {
+        args[i].map = m;
+        args[i].thread = i;
+        args[i].ok = true;
+        print_test(pthread_create(&threads[i], NULL, put_keys, &args[i]) == 0, "Create a thread that puts pairs");
+    }
+    for (int i = 0 ; i < THREADS ; i++) {
+        pthread_join(threads[i], NULL);
+        ok = ok && args[i].ok;
+    }
+    print_test(ok, "Every thread stored its pairs correctly");
+    print_test(concurrent_map_size(m) == THREADS * BULK_AMOUNT, "The concurrent map stores the pairs of every thread");
+
+    for (int i = 0 ; i < THREADS ; i++) {
+        print_test(pthread_create(&threads[i], NULL, get_and_remove_keys, &args[i]) == 0, "Create a thread that gets and removes pairs");
+    }
+    for (int i = 0 ; i < THREADS ; i++) {
+        pthread_join(threads[i], NULL);
+        ok = ok && args[i].ok;
+    }
+    print_test(ok, "Every thread found the values of its pairs and removed them");
+    print_test(concurrent_map_size(m) == 0, "The concurrent map is empty after every thread removed its pairs");
+
+    concurrent_map_destroy(m);
+}
+
+static void test_concurrent_map_builders(void) {
+    printf("TEST: Many threads build a concurrent map and visit it in parallel\n");
+
+    ConcurrentMap m = concurrent_map_create(free, 0);
+    pthread_t threads[THREADS];
+    ThreadArgs args[THREADS];
+    bool ok = true;
+
+    for (int i = 0 ; i < THREADS ; i++) {
+        args[i].map = m;
+        args[i].thread = i;
+        args[i].ok = true;
+        print_test(pthread_create(&threads[i], NULL, build_keys, &args[i]) == 0, "Create a thread that builds pairs");
+    }
+    for (int i = 0 ; i < THREADS ; i++) {
+        pthread_join(threads[i], NULL);
+        ok = ok && args[i].ok;
+    }
+    print_test(ok, "Every builder put its pairs correctly");
+    print_test(concurrent_map_size(m) == THREADS * BULK_AMOUNT, "The concurrent map stores the pairs of every builder");
+
+    char current_key[20];
+    for (int i = 0 ; i < THREADS && ok ; i++) {
+        for (int j = 0 ; j < BULK_AMOUNT && ok ; j++) {
+            sprintf(current_key, "%d-%d", i, j);
+            int* ptr = (int*)concurrent_map_get(m, current_key);
+            ok = ptr != NULL && *ptr == j;
+        }
+    }
+    print_test(ok, "Every key put by a builder has the correct value");
+
+    size_t counter = 0;
+    concurrent_map_for_each_parallel(m, count_pairs_atomically, &counter, 4);
+    print_test(counter == THREADS * BULK_AMOUNT, "The parallel iterator visits every pair");
+
+    long sum = 0;
+    concurrent_map_for_each_parallel(m, sum_values_atomically, &sum, 0);
+    print_test(sum == (long)THREADS * BULK_AMOUNT * (BULK_AMOUNT - 1) / 2, "The parallel iterator visits every value once");
+
+    counter = 0;
+    concurrent_map_for_each_parallel(m, stop_after_first, &counter, 4);
+    print_test(counter >= 1 && counter <= 4, "The parallel iterator stops when a visit function returns false");
+
+    ConcurrentMapBuilder builder = concurrent_map_builder_create(m);
+    int* value = (int*)malloc(sizeof(int));
+    print_test(value != NULL, "");
+    *value = -1;
+    print_test(concurrent_map_builder_put(builder, "0-0", value), "A builder updates a pair");
+    print_test(*(int*)concurrent_map_get(m, "0-0") == 0, "The pair is not updated before the builder is flushed");
+    print_test(concurrent_map_builder_flush(builder), "The builder is flushed");
+    print_test(*(int*)concurrent_map_get(m, "0-0") == -1, "The pair is updated after the builder is flushed");
+    concurrent_map_builder_destroy(builder);
+
+    concurrent_map_destroy(m);
+}
+
+int main(void) {
+    test_new_concurrent_map();
+    test_concurrent_map_one_thread();
+    test_concurrent_map_many_threads();
+    test_concurrent_map_builders();
+
+    return 0;
+}
+
+void print_test(bool success, const char* msg) {
+    char result[10 + (int)strlen(msg)];
+    sprintf(result, "FAIL: %s\n", msg);
+    assert_msg(success, result);
+}
+
+void *put_keys(void *args) {
+    ThreadArgs* thread_args = (ThreadArgs*)args;
+    char current_key[20];
+
+    for (int i = 0 ; i < BULK_AMOUNT && thread_args->ok ; i++) {
+        sprintf(current_key, "%d-%d", thread_args->thread, i);
+        int* value = (int*)malloc(sizeof(int));
+        if (value == NULL) {
+            thread_args->ok = false;
+            break;
+        }
+        *value = i;
+        thread_args->ok = concurrent_map_put(thread_args->map, current_key, value);
+    }
+
+    return NULL;
+}
+
+void *get_and_remove_keys(void *args) {
+    ThreadArgs* thread_args = (ThreadArgs*)args;
+    char current_key[20];
+
+    for (int i = 0 ; i < BULK_AMOUNT && thread_args->ok ; i++) {
+        sprintf(current_key, "%d-%d", thread_args->thread, i);
+        int* ptr = (int*)concurrent_map_get(thread_args->map, current_key);
+        thread_args->ok = ptr != NULL && *ptr == i;
+
+        ptr = (int*)concurrent_map_remove(thread_args->map, current_key);
+        thread_args->ok = thread_args->ok && ptr != NULL && *ptr == i;
+        free(ptr);
+    }
+
+    return NULL;
+}
+
+bool count_pairs(const char *key, void *value, void *extra) {
+    *(size_t*)extra += 1;
+    return true;
+}
+
+bool stop_at_first(const char *key, void *value, void *extra) {
+    *(size_t*)extra += 1;
+    return false;
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../map/frozen_map.h"
+#include "assert_msg.h"
+
+#define FILE_PATH "frozen_map_test.bin"
+
+static void print_test(bool, const char*);
+static bool count_pairs(const char *key, void *value, void *extra);
+static const void *serialize_int(void *value, size_t *len);
+static const void *serialize_even_int(void *value, size_t *len);
+
+static void test_freeze_empty_map(void) {
+    printf("TEST: An empty map is frozen correctly.\n");
+
+    Map m = map_create(NULL);
+    FrozenMap frozen = map_freeze(m);
+
+    print_test(frozen != NULL, "Freeze an empty map");
+    print_test(frozen_map_size(frozen) == 0, "A frozen empty map must be empty");
+    print_test(frozen_map_get(frozen, "key") == NULL, "A frozen empty map returns NULL, for any key, if it tries to get a value");
+    print_test(!frozen_map_contains(frozen, "key"), "A frozen empty map does not contain any key");
+
+    frozen_map_destroy(frozen);
+    map_destroy(m);
+}
+
+static void test_freeze_map(void) {
+    printf("TEST: Every pair of a map is found in its frozen map\n");
+
+    Map m = map_create(NULL);
+    int values[BULK_AMOUNT];
+    char current_key[20];
+    bool ok = true;
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "key-%d", i);
+        values[i] = i;
+        ok = map_put(m, current_key, &values[i]);
+    }
+    print_test(ok, "The pairs are stored correctly");
+
+    FrozenMap frozen = map_freeze(m);
+    print_test(frozen != NULL, "Freeze the map");
+    print_test(frozen_map_size(frozen) == BULK_AMOUNT, "The frozen map has the same amount of pairs as the map");
+
+    map_put(m, "key-0", NULL);
+    map_remove(m, "key-1");
+    print_test(frozen_map_get(frozen, "key-0") == &values[0], "Changing the map does not change the frozen map");
+    print_test(frozen_map_contains(frozen, "key-1"), "Removing a key from the map does not remove it from the frozen map");
+    map_destroy(m);
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "key-%d", i);
+        int* ptr = (int*)frozen_map_get(frozen, current_key);
+        ok = ptr != NULL && *ptr == i;
+    }
+    print_test(ok, "Every key has the correct value after the map is destroyed");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "missing-%d", i);
+        ok = !frozen_map_contains(frozen, current_key) && frozen_map_get(frozen, current_key) == NULL;
+    }
+    print_test(ok, "No key that was not stored is found");
+    print_test(!frozen_map_contains(frozen, ""), "The empty key is not found");
+
+    size_t counter = 0;
+    frozen_map_for_each(frozen, count_pairs, &counter);
+    print_test(counter == BULK_AMOUNT, "The internal iterator visits every pair");
+
+    frozen_map_destroy(frozen);
+}
+
+static void test_freeze_small_maps(void) {
+    printf("TEST: Maps of every small size are frozen correctly\n");
+
+    char current_key[20];
+    bool ok = true;
+
+    for (int size = 1 ; size <= 64 && ok ; size++) {
+        Map m = map_create(NULL);
+        for (int i = 0 ; i < size ; i++) {
+            sprintf(current_key, "%d", i);
+            map_put(m, current_key, current_key + (i % 10));
+        }
+
+        FrozenMap frozen = map_freeze(m);
+        ok = frozen != NULL && frozen_map_size(frozen) == (size_t)size;
+        for (int i = 0 ; i < size && ok ; i++) {
+            sprintf(current_key, "%d", i);
+            ok = frozen_map_get(frozen, current_key) == map_get(m, current_key);
+        }
+        sprintf(current_key, "%d", size);
+        ok = ok && !frozen_map_contains(frozen, current_key);
+
+        frozen_map_destroy(frozen);
+        map_destroy(m);
+    }
+    print_test(ok, "Every key of the small maps has the correct value");
+}
+
+static void test_save_and_open_map(void) {
+    printf("TEST: A saved map is opened from its file with every pair\n");
+
+    Map m = map_create(NULL);
+    int values[BULK_AMOUNT];
+    char current_key[40];
+    bool ok = true;
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, i % 2 == 0 ? "key-%d" : "a-key-longer-than-sixteen-bytes-%d", i);
+        values[i] = i;
+        ok = map_put(m, current_key, &values[i]);
+    }
+    print_test(ok, "The pairs are stored correctly");
+    print_test(map_save(m, FILE_PATH, serialize_int), "Save the map to a file");
+    map_destroy(m);
+
+    FrozenMap opened = map_open_mmap(FILE_PATH);
+    print_test(opened != NULL, "Open the saved map");
+    print_test(frozen_map_size(opened) == BULK_AMOUNT, "The opened map has the same amount of pairs as the saved map");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, i % 2 == 0 ? "key-%d" : "a-key-longer-than-sixteen-bytes-%d", i);
+        int* ptr = (int*)frozen_map_get(opened, current_key);
+        ok = ptr != NULL && ptr != &values[i] && *ptr == i;
+    }
+    print_test(ok, "Every key has a copy of its value in the opened map");
+    print_test(!frozen_map_contains(opened, "missing"), "A key that was not saved is not found");
+
+    size_t counter = 0;
+    frozen_map_for_each(opened, count_pairs, &counter);
+    print_test(counter == BULK_AMOUNT, "The internal iterator visits every pair of the opened map");
+    frozen_map_destroy(opened);
+
+    m = map_create(NULL);
+    for (int i = 0 ; i < AMOUNT ; i++) {
+        sprintf(current_key, "%d", i);
+        map_put(m, current_key, &values[i]);
+    }
+    print_test(map_save(m, FILE_PATH, serialize_even_int), "Save a map without some of its values");
+    map_destroy(m);
+
+    opened = map_open_mmap(FILE_PATH);
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        int* ptr = (int*)frozen_map_get(opened, current_key);
+        ok = frozen_map_contains(opened, current_key) && (i % 2 == 0 ? ptr != NULL && *ptr == i : ptr == NULL);
+    }
+    print_test(ok, "The keys whose values were not saved are found without a value");
+    frozen_map_destroy(opened);
+
+    m = map_create(NULL);
+    print_test(map_save(m, FILE_PATH, NULL), "Save an empty map");
+    map_destroy(m);
+    opened = map_open_mmap(FILE_PATH);
+    print_test(opened != NULL && frozen_map_size(opened) == 0, "The opened empty map is empty");
+    frozen_map_destroy(opened);
+
+    m = map_create(NULL);
+    map_put(m, "a-key-longer-than-sixteen-bytes", &values[0]);
+    print_test(map_save(m, FILE_PATH, serialize_int), "Save a map with a single pair");
+    map_destroy(m);
+
+    // The file ends with the slot of the pair: its hash, the offset of its value and its key
+    uint64_t wrong_offset = UINT64_MAX - 1;
+    FILE *file = fopen(FILE_PATH, "r+b");
+    fseek(file, -24, SEEK_END);
+    fwrite(&wrong_offset, sizeof(wrong_offset), 1, file);
+    fclose(file);
+    print_test(map_open_mmap(FILE_PATH) == NULL, "A file with a value outside of it is not opened");
+
+    uint64_t no_value = UINT64_MAX;
+    file = fopen(FILE_PATH, "r+b");
+    fseek(file, -24, SEEK_END);
+    fwrite(&no_value, sizeof(no_value), 1, file);
+    fwrite(&wrong_offset, sizeof(wrong_offset), 1, file);
+    fclose(file);
+    print_test(map_open_mmap(FILE_PATH) == NULL, "A file with a key outside of it is not opened");
+
+    file = fopen(FILE_PATH, "wb");
+    fputs("this is not a frozen map, but it is long enough to have a header", file);
+    fclose(file);
+    print_test(map_open_mmap(FILE_PATH) == NULL, "A file that is not a saved map is not opened");
+    remove(FILE_PATH);
+    print_test(map_open_mmap(FILE_PATH) == NULL, "A file that does not exist is not opened");
+}
+
+int main(void) {
+    test_freeze_empty_map();
+    test_freeze_map();
+    test_freeze_small_maps();
+    test_save_and_open_map();
+
+    return 0;
+}
+
+void print_test(bool success, const char* msg) {
+    char result[10 + (int)strlen(msg)];
+    sprintf(result, "FAIL: %s\n", msg);
+    assert_msg(success, result);
+}
+
+bool count_pairs(const char *key, void *value, void *extra) {
+    *(size_t*)extra += 1;
+    return true;
+}
+
+const void *serialize_int(void *value, size_t *len) {
+    *len = sizeof(int);
+    return value;
+}
+
+const void *serialize_even_int(void *value, size_t *len) {
+    *len = sizeof(int);
+    return *(int*)value % 2 == 0 ? value : NULL;
+}
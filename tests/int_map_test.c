@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../map/int_map.h"
+#include "assert_msg.h"
+
+static void print_test(bool, const char*);
+static bool sum_pairs(uint64_t key, void *value, void *extra);
+static bool stop_at_first(uint64_t key, void *value, void *extra);
+
+static void test_new_int_map(void) {
+    printf("TEST: A newly created int map works as expected.\n");
+
+    IntMap m = imap_create(NULL);
+
+    print_test(m != NULL, "Create a new int map");
+    print_test(imap_size(m) == 0, "A newly created int map must be empty");
+    print_test(imap_get(m, 0) == NULL, "An empty int map returns NULL, for any key, if it tries to get a value");
+    print_test(imap_remove(m, 1) == NULL, "An empty int map returns NULL, for any key, if it tries to remove");
+    print_test(!imap_contains(m, UINT64_MAX), "An empty int map does not contain any key");
+
+    imap_destroy(m);
+}
+
+static void test_int_map_pairs(void) {
+    printf("TEST: Put, get, update and remove many integer keys\n");
+
+    IntMap m = imap_create(free);
+    bool ok = true;
+
+    for (uint64_t i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        uint64_t* value = (uint64_t*)malloc(sizeof(uint64_t));
+        print_test(value != NULL, "");
+        *value = i;
+        ok = imap_put(m, i * 4096, value);
+    }
+    print_test(ok, "The pairs are stored correctly");
+    print_test(imap_size(m) == BULK_AMOUNT, "The amount of stored pairs is correct");
+
+    for (uint64_t i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        uint64_t* ptr = (uint64_t*)imap_get(m, i * 4096);
+        ok = ptr != NULL && *ptr == i && imap_contains(m, i * 4096) && !imap_contains(m, i * 4096 + 1);
+    }
+    print_test(ok, "Every key has the correct value, and the keys that were not put are not found");
+
+    uint64_t* value = (uint64_t*)malloc(sizeof(uint64_t));
+    print_test(value != NULL, "");
+    *value = UINT64_MAX;
+    print_test(imap_put(m, UINT64_MAX, value) && imap_get(m, UINT64_MAX) == value, "The biggest key is stored");
+    value = (uint64_t*)malloc(sizeof(uint64_t));
+    print_test(value != NULL, "");
+    *value = 7;
+    print_test(imap_put(m, 0, value) && imap_get(m, 0) == value, "The value of a key is updated");
+    print_test(imap_size(m) == BULK_AMOUNT + 1, "The size does not change after updating a pair");
+
+    uint64_t sum = 0;
+    imap_for_each(m, sum_pairs, &sum);
+    print_test(sum == (uint64_t)BULK_AMOUNT * (BULK_AMOUNT - 1) / 2 + 7 + UINT64_MAX, "The internal iterator visits every pair");
+
+    size_t counter = 0;
+    imap_for_each(m, stop_at_first, &counter);
+    print_test(counter == 1, "The internal iterator stops when the visit function returns false");
+
+    for (uint64_t i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        uint64_t* ptr = (uint64_t*)imap_remove(m, i * 4096);
+        ok = ptr != NULL && *ptr == (i == 0 ? 7 : i) && !imap_contains(m, i * 4096);
+        free(ptr);
+    }
+    print_test(ok, "Every pair is removed correctly");
+    print_test(imap_size(m) == 1 && imap_contains(m, UINT64_MAX), "Only the pair that was not removed is stored");
+
+    imap_destroy(m);
+}
+
+static void test_int_map_entries(void) {
+    printf("TEST: Count integer keys with their entries\n");
+
+    IntMap m = imap_create(NULL);
+    bool ok = imap_reserve(m, AMOUNT), inserted;
+
+    for (int i = 0 ; i < AMOUNT * 3 && ok ; i++) {
+        void** value = imap_entry(m, (uint64_t)(i % AMOUNT), &inserted);
+        ok = value != NULL && inserted == (i < AMOUNT);
+        if (ok) *value = (void*)((intptr_t)*value + 1);
+    }
+    print_test(ok, "Each key is added by its first entry");
+
+    for (int i = 0 ; i < AMOUNT && ok ; i++) ok = (intptr_t)imap_get(m, (uint64_t)i) == 3;
+    print_test(ok, "Every key has counted its entries");
+
+    print_test(!imap_reserve(m, SIZE_MAX) && !imap_reserve(m, SIZE_MAX / 4), "Reserving room for more pairs than an int map can hold fails");
+    print_test(imap_size(m) == AMOUNT && (intptr_t)imap_get(m, 0) == 3, "The int map keeps its pairs after a failed reserve");
+
+    imap_destroy(m);
+}
+
+static void test_int_map_churn(void) {
+    printf("TEST: Keep putting new keys and removing old ones so the size of the int map stays the same\n");
+
+    IntMap m = imap_create(NULL);
+    bool ok = true;
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        ok = imap_put(m, (uint64_t)i, (void*)(intptr_t)(i + 1));
+        if (i >= AMOUNT - 1) ok = ok && (intptr_t)imap_remove(m, (uint64_t)(i - (AMOUNT - 1))) == i - (AMOUNT - 1) + 1;
+        ok = ok && imap_size(m) < AMOUNT && (intptr_t)imap_get(m, (uint64_t)i) == i + 1;
+    }
+    print_test(ok && imap_size(m) == AMOUNT - 1, "The keys are put and removed correctly while the size stays the same");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        ok = imap_contains(m, (uint64_t)i) == (i >= BULK_AMOUNT - (AMOUNT - 1));
+    }
+    print_test(ok, "Only the last keys put are still in the int map");
+
+    imap_destroy(m);
+}
+
+int main(void) {
+    test_new_int_map();
+    test_int_map_pairs();
+    test_int_map_entries();
+    test_int_map_churn();
+
+    return 0;
+}
+
+void print_test(bool success, const char* msg) {
+    char result[10 + (int)strlen(msg)];
+    sprintf(result, "FAIL: %s\n", msg);
+    assert_msg(success, result);
+}
+
+bool sum_pairs(uint64_t key, void *value, void *extra) {
+    *(uint64_t*)extra += *(uint64_t*)value;
+    return true;
+}
+
+bool stop_at_first(uint64_t key, void *value, void *extra) {
+    *(size_t*)extra += 1;
+    return false;
+}
@@ -9,12 +9,40 @@ typedef struct {
     int integer;
 } MyStruct;
 
+typedef struct {
+    int32_t number;
+    int32_t updates;
+    char name[12];
+} SizedValue;
+
 static void print_test(bool, const char*);
 static MyStruct* struct_create(char* string, int integer);
 static void struct_destroy(void* value);
 static bool sum_values(const char* key, void* value, void* extra);
 static bool smaller_than_pi(const char *key, void *value, void *extra);
 static bool sum_key_length(const char *key, void *value, void *extra);
+static uint64_t colliding_hash(const void *key, size_t len, uint64_t seed);
+static void *count_update(void *value, bool inserted, void *extra);
+static void count_sized_destroy(void *value);
+static bool sum_sized_values(const char *key, void *value, void *extra);
+static void *sized_update(void *value, bool inserted, void *extra);
+#ifdef MAP_INSERTION_ORDER
+static bool check_order(const char *key, void *value, void *extra);
+#endif
+
+static size_t hash_calls = 0;
+static bool hash_len_ok = true;
+static size_t sized_destroyed = 0;
+
+#ifdef MAP_INSERTION_ORDER
+// The keys that an iteration is expected to visit, in order, and how many it visited
+typedef struct {
+    char keys[AMOUNT][16];
+    size_t amount;
+    size_t visited;
+    bool ok;
+} KeyOrder;
+#endif
 
 static void test_new_map(void) {
     printf("TEST: A newly created map works as expected.\n");
@@ -253,6 +281,456 @@ void test_key_reutilization(void) {
     map_destroy(m);
 }
 
+void test_churn_at_steady_size(void) {
+    printf("TEST: Keep putting new pairs and removing old ones so the size of the map stays the same, and check that every pair is still found\n");
+
+    Map m = map_create(NULL);
+    char current_key[10], old_key[10];
+    int values[AMOUNT];
+    bool ok = true;
+    map_stats_t stats;
+    size_t steady_capacity = 0, max_capacity = 0;
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "k%d", i);
+        values[i % AMOUNT] = i;
+        ok = map_put(m, current_key, &values[i % AMOUNT]);
+
+        map_stats(m, &stats);
+        if (i == BULK_AMOUNT / 2) steady_capacity = stats.capacity;
+        if (i > BULK_AMOUNT / 2 && stats.capacity > max_capacity) max_capacity = stats.capacity;
+
+        if (i >= AMOUNT - 1) {
+            sprintf(old_key, "k%d", i - (AMOUNT - 1));
+            int* ptr = (int*)map_remove(m, old_key);
+            ok = ok && ptr != NULL && *ptr == i - (AMOUNT - 1) && !map_contains(m, old_key);
+        }
+        ok = ok && map_size(m) < AMOUNT && map_get(m, current_key) == &values[i % AMOUNT];
+    }
+    print_test(ok, "The pairs are stored and removed correctly while the size of the map stays the same");
+    print_test(map_size(m) == AMOUNT - 1, "The size of the map did not change after all the puts and removes");
+    print_test(max_capacity <= steady_capacity, "The deleted slots do not make the table grow while the size stays the same");
+
+    for (int i = BULK_AMOUNT - (AMOUNT - 1) ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "k%d", i);
+        int* ptr = (int*)map_get(m, current_key);
+        ok = ptr != NULL && *ptr == i;
+    }
+    print_test(ok, "The last pairs stored are still in the map");
+
+    map_destroy(m);
+}
+
+void test_keys_of_every_length(void) {
+    printf("TEST: Store keys of many different lengths, short and long, and check that every pair is found\n");
+
+    Map m = map_create(NULL);
+    char key[AMOUNT * 2 + 1];
+    int values[AMOUNT * 2];
+    bool ok = true;
+
+    for (int i = 0 ; i < AMOUNT * 2 && ok ; i++) {
+        memset(key, 'a' + i % 26, (size_t)i);
+        key[i] = '\0';
+        values[i] = i;
+        ok = map_put(m, key, &values[i]);
+    }
+    print_test(ok, "The pairs with keys of every length are stored correctly");
+    print_test(map_size(m) == AMOUNT * 2, "The amount of stored pairs is correct");
+
+    for (int i = 0 ; i < AMOUNT * 2 && ok ; i += 2) {
+        memset(key, 'a' + i % 26, (size_t)i);
+        key[i] = '\0';
+        ok = map_remove(m, key) == &values[i];
+    }
+    print_test(ok, "The pairs with keys of every length are removed correctly");
+
+    for (int i = 0 ; i < AMOUNT * 2 && ok ; i++) {
+        memset(key, 'a' + i % 26, (size_t)i);
+        key[i] = '\0';
+        ok = i % 2 == 0 ? !map_contains(m, key) : map_get(m, key) == &values[i];
+        if (ok && i % 2 == 1) {
+            key[i - 1] = '\0';
+            ok = !map_contains(m, key);
+        }
+    }
+    print_test(ok, "The pairs left have the correct values, and a prefix of a key is not found");
+
+    map_destroy(m);
+}
+
+void test_binary_keys(void) {
+    printf("TEST: Store keys given with their length, which may have zero bytes or be part of a bigger buffer\n");
+
+    Map m = map_create(NULL);
+    const char buffer[] = "xxabcxx";
+    int values[4] = {0, 1, 2, 3};
+
+    print_test(map_put_n(m, "a\0b", 3, &values[0]), "A key with a zero byte is stored correctly");
+    print_test(map_put_n(m, "a\0c", 3, &values[1]), "Another key with the same bytes before the zero byte is stored correctly");
+    print_test(map_put_n(m, "a", 1, &values[2]), "A key that is a prefix of the others is stored correctly");
+    print_test(map_put_n(m, "", 0, &values[3]), "An empty key is stored correctly");
+    print_test(map_size(m) == 4, "Every key is a different pair in the map");
+
+    print_test(map_get_n(m, "a\0b", 3) == &values[0], "The value of the first key with a zero byte is correct");
+    print_test(map_get_n(m, "a\0c", 3) == &values[1], "The value of the second key with a zero byte is correct");
+    print_test(map_get(m, "a") == &values[2], "The key given with its length is the same as the string key");
+    print_test(map_get(m, "") == &values[3], "The empty key is the same as the empty string");
+    print_test(!map_contains_n(m, "a\0", 2), "A part of a key is not contained in the map");
+
+    print_test(map_put(m, "abc", &values[0]), "A string key is stored correctly");
+    print_test(map_contains_n(m, buffer + 2, 3), "The string key is found with a part of a bigger buffer");
+    print_test(map_get_n(m, buffer + 2, 3) == &values[0], "The value is found with a part of a bigger buffer");
+    print_test(map_remove_n(m, buffer + 2, 3) == &values[0], "The pair is removed with a part of a bigger buffer");
+    print_test(!map_contains(m, "abc"), "The removed key is not contained in the map");
+
+    print_test(map_remove_n(m, "a\0b", 3) == &values[0], "The key with a zero byte is removed correctly");
+    print_test(map_get_n(m, "a\0c", 3) == &values[1], "The other key with a zero byte is still stored");
+    print_test(map_size(m) == 3, "The size of the map is correct after removing the keys");
+
+    map_destroy(m);
+}
+
+void test_custom_hash_function(void) {
+    printf("TEST: A map created with a custom hash function uses it, and works even if every key has the same hash\n");
+
+    Map m = map_create_with_hash(NULL, colliding_hash, 7);
+    char current_key[3];
+    int values[AMOUNT];
+    bool ok = true;
+
+    print_test(m != NULL, "Create a new map with a custom hash function");
+
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        values[i] = i;
+        ok = map_put(m, current_key, &values[i]);
+    }
+    print_test(ok, "The pairs are stored correctly when all the keys collide");
+    print_test(hash_calls > 0, "The custom hash function was used");
+    print_test(hash_len_ok, "The custom hash function receives the length of the key and the seed");
+
+    for (int i = 0 ; i < AMOUNT && ok ; i += 2) {
+        sprintf(current_key, "%d", i);
+        ok = map_remove(m, current_key) == &values[i];
+    }
+    print_test(ok, "The pairs are removed correctly when all the keys collide");
+
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = i % 2 == 0 ? !map_contains(m, current_key) : map_get(m, current_key) == &values[i];
+    }
+    print_test(ok, "The pairs left have the correct values when all the keys collide");
+    print_test(map_size(m) == AMOUNT / 2, "The size of the map is correct after removing half of the pairs");
+
+    map_destroy(m);
+
+    m = map_create_with_hash(NULL, NULL, 0);
+    print_test(m != NULL, "Create a new map with the built-in hash function and a fixed seed");
+    print_test(map_put(m, "key", &values[0]) && map_get(m, "key") == &values[0], "The pair is stored correctly");
+    map_destroy(m);
+}
+
+void test_reserve_and_shrink(void) {
+    printf("TEST: A map created with a capacity, reserved or shrunk keeps working and keeps its pairs\n");
+
+    Map m = map_create_with_capacity(free, BULK_AMOUNT);
+    char current_key[10];
+    bool ok = true;
+
+    print_test(m != NULL, "Create a new map with room for a huge amount of pairs");
+    print_test(map_size(m) == 0, "A map created with a capacity must be empty");
+
+    map_stats_t stats;
+    map_stats(m, &stats);
+    print_test(stats.resizes == 0 && stats.capacity >= BULK_AMOUNT, "A map created with a capacity gets its table without resizing");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        int* value = (int*)malloc(sizeof(int));
+        print_test(value != NULL, "");
+        *value = i;
+        ok = map_put(m, current_key, value);
+    }
+    print_test(ok && map_size(m) == BULK_AMOUNT, "The huge amount of pairs is stored correctly");
+
+    print_test(map_reserve(m, BULK_AMOUNT * 4), "Reserve room for more pairs than the ones stored");
+    print_test(map_reserve(m, 1), "Reserve room for less pairs than the ones stored");
+
+    for (int i = AMOUNT ; i < BULK_AMOUNT ; i++) {
+        sprintf(current_key, "%d", i);
+        free(map_remove(m, current_key));
+    }
+    print_test(map_shrink_to_fit(m), "Shrink the map after removing most of its pairs");
+    print_test(map_size(m) == AMOUNT, "The size of the map does not change after shrinking it");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        int* ptr = (int*)map_get(m, current_key);
+        ok = i < AMOUNT ? ptr != NULL && *ptr == i : ptr == NULL;
+    }
+    print_test(ok, "The pairs left are still found after shrinking the map, and the removed ones are not");
+
+    map_destroy(m);
+
+    m = map_create(NULL);
+    print_test(map_shrink_to_fit(m) && map_size(m) == 0, "An empty map can be shrunk");
+    print_test(map_reserve(m, 0) && map_size(m) == 0, "Reserving room for no pairs does not change an empty map");
+    print_test(!map_reserve(m, SIZE_MAX) && !map_reserve(m, SIZE_MAX / 4), "Reserving room for more pairs than a map can hold fails");
+    print_test(map_put(m, "key", NULL) && map_contains(m, "key") && map_size(m) == 1, "The map keeps working after a failed reserve");
+    map_destroy(m);
+
+    print_test(map_create_with_capacity(NULL, SIZE_MAX) == NULL, "A map can not be created with room for more pairs than it can hold");
+}
+
+void test_get_many(void) {
+    printf("TEST: Get and check many keys at once, some of them stored in the map and some not\n");
+
+    Map m = map_create(NULL);
+    char storage[AMOUNT * 2][10];
+    const char* keys[AMOUNT * 2];
+    void* values[AMOUNT * 2];
+    bool found[AMOUNT * 2];
+    int stored_values[AMOUNT];
+    bool ok = true;
+
+    for (int i = 0 ; i < AMOUNT * 2 ; i++) {
+        sprintf(storage[i], "%d", i);
+        keys[i] = storage[i];
+        if (i % 2 == 0) {
+            stored_values[i / 2] = i;
+            map_put(m, storage[i], &stored_values[i / 2]);
+        }
+    }
+
+    print_test(map_get_many(m, keys, AMOUNT * 2, values) == AMOUNT, "The amount of keys found is the amount of keys stored");
+    for (int i = 0 ; i < AMOUNT * 2 && ok ; i++) ok = i % 2 == 0 ? values[i] == &stored_values[i / 2] : values[i] == NULL;
+    print_test(ok, "Every stored key gets its value, and the missing ones get NULL");
+
+    print_test(map_contains_many(m, keys, AMOUNT * 2, found) == AMOUNT, "The amount of keys contained is the amount of keys stored");
+    for (int i = 0 ; i < AMOUNT * 2 && ok ; i++) ok = found[i] == (i % 2 == 0);
+    print_test(ok, "Only the stored keys are contained in the map");
+
+    print_test(map_get_many(m, keys, 0, values) == 0, "Getting no keys finds nothing");
+
+    map_destroy(m);
+}
+
+void test_entry_and_update(void) {
+    printf("TEST: Count keys with the entries and updates of their values\n");
+
+    Map m = map_create(NULL);
+    char current_key[10];
+    bool ok = true, inserted;
+
+    for (int i = 0 ; i < BULK_AMOUNT * 2 && ok ; i++) {
+        sprintf(current_key, "%d", i % BULK_AMOUNT);
+        void** value = map_entry(m, current_key, &inserted);
+        ok = value != NULL && inserted == (i < BULK_AMOUNT) && (!inserted || *value == NULL);
+        if (ok) *value = (void*)((intptr_t)*value + 1);
+    }
+    print_test(ok, "Each key is added by its first entry, with a NULL value");
+    print_test(map_size(m) == BULK_AMOUNT, "The amount of stored pairs is the amount of different keys");
+
+    size_t updates = 0;
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_update(m, current_key, count_update, &updates);
+    }
+    print_test(ok && updates == BULK_AMOUNT, "The value of every key is updated");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = (intptr_t)map_get(m, current_key) == 3;
+    }
+    print_test(ok, "Every key has counted its entries and updates");
+
+    print_test(map_update(m, "new", count_update, &updates), "Update a key that is not stored");
+    print_test((intptr_t)map_get(m, "new") == 1 && updates == BULK_AMOUNT + 1, "The key is added with the value given by the update");
+
+    void** value = map_entry_n(m, "a\0b", 3, &inserted);
+    print_test(value != NULL && inserted, "An entry for a key with a zero byte is added");
+    *value = &updates;
+    print_test(map_get_n(m, "a\0b", 3) == &updates && map_entry_n(m, "a\0b", 3, NULL) == value, "The value stored through the entry is found");
+
+    map_destroy(m);
+}
+
+void test_sized_values(void) {
+    printf("TEST: Store the bytes of the values inside a map created with a value size\n");
+
+    print_test(map_create_sized(0, NULL) == NULL, "A map can not be created with values of 0 bytes");
+
+    Map m = map_create_sized(sizeof(SizedValue), count_sized_destroy);
+    char current_key[10];
+    bool ok = m != NULL;
+    print_test(ok, "Create a map with values of a fixed size");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        SizedValue value = {i, 0, ""};
+        sprintf(value.name, "v%d", i);
+        sprintf(current_key, "%d", i);
+        ok = map_put(m, current_key, &value);
+    }
+    print_test(ok && map_size(m) == BULK_AMOUNT, "Every value is copied into the map");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        char name[12];
+        sprintf(name, "v%d", i);
+        sprintf(current_key, "%d", i);
+        SizedValue *value = (SizedValue*)map_get(m, current_key);
+        ok = value != NULL && value->number == i && strcmp(value->name, name) == 0;
+    }
+    print_test(ok, "The copies are kept while the map is resized");
+
+    long long sum = 0, expected_sum = (long long)BULK_AMOUNT * (BULK_AMOUNT - 1) / 2;
+    map_for_each(m, sum_sized_values, &sum);
+    print_test(sum == expected_sum, "The visit function receives the address of every value");
+
+    SizedValue replacement = {-1, 0, "replaced"};
+    print_test(map_put(m, "0", &replacement) && sized_destroyed == 1, "Putting a stored key destroys the value it replaces");
+    print_test(((SizedValue*)map_get(m, "0"))->number == -1, "The new value is copied over the old one");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_update(m, current_key, sized_update, NULL) && ((SizedValue*)map_get(m, current_key))->updates == 1;
+    }
+    print_test(ok, "An update can change the value in place");
+
+    bool inserted;
+    SizedValue *entry = (SizedValue*)map_entry(m, "new", &inserted);
+    print_test(entry != NULL && inserted && entry->number == 0 && entry->name[0] == '\0', "An entry adds a zeroed value");
+    entry->number = 42;
+    print_test(((SizedValue*)map_get(m, "new"))->number == 42, "The value written through the entry is stored");
+
+    SizedValue *removed = (SizedValue*)map_remove(m, "new");
+    print_test(removed != NULL && removed->number == 42 && !map_contains(m, "new"), "Removing a key returns a copy of its value");
+    print_test(sized_destroyed == 1, "The removed value is not destroyed");
+
+    sized_destroyed = 0;
+    map_destroy(m);
+    print_test(sized_destroyed == BULK_AMOUNT, "Destroying the map destroys every stored value");
+}
+
+void test_stats(void) {
+    printf("TEST: The stats of a map describe its table and the keys that collide\n");
+
+    Map m = map_create(NULL);
+    map_stats_t stats;
+    char current_key[10];
+    bool ok = true;
+
+    map_stats(m, &stats);
+    print_test(stats.size == 0 && stats.max_probe_length == 0 && stats.average_probe_length == 0, "An empty map has no probe lengths");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_put(m, current_key, NULL);
+    }
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i += 2) {
+        sprintf(current_key, "%d", i);
+        map_remove(m, current_key);
+        ok = !map_contains(m, current_key);
+    }
+    print_test(ok, "Half of the pairs put are removed");
+
+    map_stats(m, &stats);
+    size_t counted = 0;
+    for (size_t i = 0 ; i < MAP_PROBE_LENGTHS ; i++) counted += stats.probe_lengths[i];
+    print_test(stats.size == BULK_AMOUNT / 2 && stats.capacity >= stats.size, "The stats have the size and capacity of the map");
+    print_test(counted == stats.size, "Every pair is counted once by its probe length");
+    print_test(stats.average_probe_length <= (double)stats.max_probe_length, "The average probe length is not greater than the maximum");
+    print_test(stats.resizes > 0 && stats.resize_seconds >= 0, "The resizes of the table are counted");
+
+#ifdef MAP_STATS_COUNTERS
+    print_test(stats.puts == BULK_AMOUNT && stats.removes == BULK_AMOUNT / 2 && stats.gets == BULK_AMOUNT / 2, "Every operation is counted");
+    print_test(stats.probes > 0, "The slots checked by the searches are counted");
+#else
+    print_test(stats.puts == 0 && stats.gets == 0 && stats.probes == 0, "The operations are not counted without MAP_STATS_COUNTERS");
+#endif
+
+    map_destroy(m);
+
+    m = map_create_with_hash(NULL, colliding_hash, 7);
+    for (int i = 0 ; i < AMOUNT ; i++) {
+        sprintf(current_key, "%d", i);
+        map_put(m, current_key, NULL);
+    }
+    map_stats(m, &stats);
+    print_test(stats.max_probe_length > 0 && stats.probe_lengths[0] < AMOUNT, "The keys with the same hash have longer probe lengths");
+    map_destroy(m);
+}
+
+void test_filter(void) {
+    printf("TEST: A map with a filter finds the keys it stores and no other key\n");
+
+    Map m = map_create(NULL);
+    char current_key[16];
+    bool ok = map_enable_filter(m);
+    print_test(ok, "A filter is enabled in an empty map");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_put(m, current_key, (void*)(intptr_t)(i + 1));
+    }
+    print_test(ok, "Many pairs are put after enabling the filter");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_get(m, current_key) == (void*)(intptr_t)(i + 1);
+    }
+    print_test(ok, "Every key put is found after the map grows");
+
+    for (int i = BULK_AMOUNT ; i < 2 * BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = !map_contains(m, current_key) && map_get(m, current_key) == NULL && map_remove(m, current_key) == NULL;
+    }
+    print_test(ok && map_size(m) == BULK_AMOUNT, "The keys that were not put are not found");
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i += 2) {
+        sprintf(current_key, "%d", i);
+        ok = map_remove(m, current_key) == (void*)(intptr_t)(i + 1) && !map_contains(m, current_key);
+    }
+    for (int i = 1 ; i < BULK_AMOUNT && ok ; i += 2) {
+        sprintf(current_key, "%d", i);
+        ok = map_contains(m, current_key);
+    }
+    print_test(ok, "The removed keys are not found and the others still are");
+
+    const char *keys[] = {"0", "1", "2", "3", "x"};
+    void *values[5];
+    print_test(map_get_many(m, keys, 5, values) == 2 && values[0] == NULL && values[1] == (void*)(intptr_t)2 && values[3] == (void*)(intptr_t)4 && values[4] == NULL, "The keys given to map_get_many are filtered too");
+    map_destroy(m);
+
+    m = map_create(NULL);
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_put(m, current_key, NULL);
+    }
+    ok = ok && map_enable_filter(m) && map_enable_filter(m);
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_contains(m, current_key);
+    }
+    print_test(ok, "A filter enabled in a filled map has every key it stores");
+    map_destroy(m);
+
+    m = map_create_with_hash(NULL, colliding_hash, 7);
+    ok = map_enable_filter(m);
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_put(m, current_key, NULL);
+    }
+    for (int i = 0 ; i < AMOUNT - 1 && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        map_remove(m, current_key);
+        ok = !map_contains(m, current_key);
+    }
+    sprintf(current_key, "%d", AMOUNT - 1);
+    print_test(ok && map_contains(m, current_key), "Keys with the same hash are kept by the filter until the last one is removed");
+    map_destroy(m);
+}
+
 void test_internal_iterator_no_cut_condition(void) {
     printf("TEST: Verifies that the internal iterator with a visit function that does not have a cut condition works fine\n");
 
@@ -315,6 +793,44 @@ void test_internal_iterator_keys(void) {
     map_destroy(m);
 }
 
+#ifdef MAP_INSERTION_ORDER
+/* Only for the implementations that iterate through the pairs in the order they were added,
+which must be kept when pairs are removed and when their entries are compacted. */
+void test_insertion_order(void) {
+    printf("TEST: The iterators visit the pairs in the order they were added\n");
+
+    Map m = map_create(NULL);
+    KeyOrder order = {.amount = 0, .visited = 0, .ok = true};
+    char current_key[16];
+    bool ok = true;
+
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "key-%d", i);
+        ok = map_put(m, current_key, NULL);
+    }
+    // Removing most of the pairs leaves more removed entries than stored ones, which are compacted
+    for (int i = 0 ; i < AMOUNT && ok ; i++) {
+        sprintf(current_key, "key-%d", i);
+        if (i % 10 == 0) sprintf(order.keys[order.amount++], "key-%d", i);
+        else ok = map_remove(m, current_key) == NULL && !map_contains(m, current_key);
+    }
+    sprintf(order.keys[order.amount++], "key-%d", 5);
+    ok = ok && map_put(m, "key-5", NULL);
+    print_test(ok && map_size(m) == order.amount, "Most of the pairs are removed and one of them is put again");
+
+    map_for_each(m, check_order, &order);
+    print_test(order.ok && order.visited == order.amount, "The internal iterator visits the pairs in the order they were added, with the one put again last");
+
+    MapIterator iter = map_iter_create(m);
+    size_t visited = 0;
+    for ( ; map_iter_has_next(iter) && ok ; map_iter_next(iter)) ok = visited < order.amount && strcmp(map_iter_get_current(iter), order.keys[visited++]) == 0;
+    print_test(ok && visited == order.amount, "The external iterator visits the pairs in the order they were added, with the one put again last");
+    map_iter_destroy(iter);
+
+    map_destroy(m);
+}
+#endif
+
 void test_iterator_for_empty_map(void) {
     printf("TEST: An iterator created for an empty map should act as an finished iterator\n");
 
@@ -361,6 +877,62 @@ void test_bulk_iterate_through_a_map(void) {
     map_destroy(m);
 }
 
+void test_iterate_values_in_batches(void) {
+    printf("TEST: Iterate through the values and hashes of a map, one pair and many pairs at a time\n");
+
+    Map m = map_create_with_hash(NULL, NULL, 42);
+    char current_key[10];
+    bool ok = true;
+
+    for (int i = 0 ; i < BULK_AMOUNT && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = map_put(m, current_key, (void*)(intptr_t)(i + 1));
+    }
+    print_test(ok, "The pairs are put in the map");
+
+    map_iter_t stack_iter;
+    MapIterator iter = map_iter_init(&stack_iter, m);
+    print_test(iter == &stack_iter && map_iter_init(NULL, m) == NULL, "An iterator is set up without allocating it");
+
+    size_t counter = 0;
+    for ( ; map_iter_has_next(iter) && ok ; map_iter_next(iter), counter++) {
+        const char *key = map_iter_get_current(iter);
+        ok = map_iter_get_value(iter) == map_get(m, key);
+    }
+    print_test(ok && counter == BULK_AMOUNT, "The iterator gives the value of each pair");
+    print_test(map_iter_get_value(iter) == NULL && map_iter_get_hash(iter) == 0, "A finished iterator has no value nor hash");
+
+    Map other = map_create_with_hash(NULL, NULL, 42);
+    map_put(other, "7", NULL);
+    map_iter_t other_iter;
+    map_iter_init(&other_iter, other);
+    for (map_iter_init(iter, m) ; strcmp(map_iter_get_current(iter), "7") != 0 ; map_iter_next(iter));
+    print_test(map_iter_get_hash(iter) == map_iter_get_hash(&other_iter), "The same key has the same hash in maps with the same seed");
+    map_destroy(other);
+
+    const char *keys[7];
+    void *values[7];
+    size_t amount, total = 0;
+    intptr_t sum = 0;
+    map_iter_init(iter, m);
+    while ((amount = map_iter_next_batch(iter, keys, values, 7)) > 0) {
+        for (size_t i = 0 ; i < amount && ok ; i++) ok = map_get(m, keys[i]) == values[i];
+        for (size_t i = 0 ; i < amount ; i++) sum += (intptr_t)values[i];
+        total += amount;
+        if (amount < 7) ok = ok && !map_iter_has_next(iter);
+    }
+    print_test(ok && total == BULK_AMOUNT && sum == (intptr_t)BULK_AMOUNT * (BULK_AMOUNT + 1) / 2, "Every pair is given once by the batches");
+
+    const char **all_keys = (const char**)malloc(BULK_AMOUNT * sizeof(char*));
+    print_test(all_keys != NULL, "");
+    map_iter_init(iter, m);
+    print_test(map_iter_next_batch(iter, NULL, values, 3) == 3 && map_iter_next_batch(iter, all_keys, NULL, BULK_AMOUNT) == BULK_AMOUNT - 3, "The keys or the values of the batches are optional");
+    print_test(map_iter_next_batch(iter, keys, values, 1) == 0, "A finished iterator gives no more batches");
+    free(all_keys);
+
+    map_destroy(m);
+}
+
 void test_struct_values(void) {
     printf("TEST: Put structs into the map and check that it works correctly\n");
 
@@ -401,12 +973,26 @@ int main(void) {
     test_huge_amount_of_pairs();
     test_emptied_map();
     test_key_reutilization();
+    test_churn_at_steady_size();
+    test_keys_of_every_length();
+    test_binary_keys();
+    test_custom_hash_function();
+    test_reserve_and_shrink();
+    test_get_many();
+    test_entry_and_update();
+    test_sized_values();
+    test_stats();
+    test_filter();
     test_internal_iterator_no_cut_condition();
     test_internal_iterator_cut_condition();
     test_internal_iterator_keys();
+#ifdef MAP_INSERTION_ORDER
+    test_insertion_order();
+#endif
 
     test_iterator_for_empty_map();
     test_bulk_iterate_through_a_map();
+    test_iterate_values_in_batches();
 
     test_struct_values();
 
@@ -456,4 +1042,39 @@ bool smaller_than_pi(const char *key, void *value, void *extra) {
 bool sum_key_length(const char *key, void *value, void *extra) {
     *(size_t*)extra += strlen(key);
     return true;
-}
\ No newline at end of file
+}
+
+uint64_t colliding_hash(const void *key, size_t len, uint64_t seed) {
+    hash_calls++;
+    if (len != strlen((const char*)key) || seed != 7) hash_len_ok = false;
+    return seed;
+}
+
+void *count_update(void *value, bool inserted, void *extra) {
+    *(size_t*)extra += 1;
+    return (void*)((intptr_t)value + 1);
+}
+
+void count_sized_destroy(void *value) {
+    sized_destroyed++;
+}
+
+bool sum_sized_values(const char *key, void *value, void *extra) {
+    *(long long*)extra += ((SizedValue*)value)->number;
+    return true;
+}
+
+void *sized_update(void *value, bool inserted, void *extra) {
+    ((SizedValue*)value)->updates++;
+    return value;
+}
+
+#ifdef MAP_INSERTION_ORDER
+bool check_order(const char *key, void *value, void *extra) {
+    KeyOrder *order = (KeyOrder*)extra;
+    if (order->visited >= order->amount || strcmp(key, order->keys[order->visited]) != 0) order->ok = false;
+    order->visited++;
+
+    return true;
+}
+#endif
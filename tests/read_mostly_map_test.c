@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../map/read_mostly_map.h"
+#include "assert_msg.h"
+
+#define READERS 4
+#define KEYS 64
+#define UPDATES 2000
+
+typedef struct {
+    ReadMostlyMap map;
+    bool *done;
+    bool ok;
+} ThreadArgs;
+
+static void print_test(bool, const char*);
+static void *read_keys(void *args);
+static void *update_keys(void *args);
+static int *new_value(int value);
+static bool count_pairs(const char *key, void *value, void *extra);
+
+static size_t destroyed = 0;
+static void count_destroyed(void *value);
+
+static void test_new_read_mostly_map(void) {
+    printf("TEST: A newly created read mostly map works as expected.\n");
+
+    ReadMostlyMap m = read_mostly_map_create(NULL);
+    ReadMostlyReader reader = read_mostly_reader_create(m);
+
+    print_test(m != NULL && reader != NULL, "Create a new read mostly map and a reader");
+    print_test(read_mostly_map_size(m) == 0, "A newly created read mostly map must be empty");
+    print_test(read_mostly_map_get(reader, "key") == NULL, "An empty read mostly map returns NULL, for any key, if it tries to get a value");
+    print_test(!read_mostly_map_remove(m, "key"), "An empty read mostly map can not remove any key");
+    print_test(!read_mostly_map_contains(reader, "key"), "An empty read mostly map does not contain any key");
+
+    read_mostly_reader_destroy(reader);
+    read_mostly_map_destroy(m);
+}
+
+static void test_read_mostly_map_retires_values(void) {
+    printf("TEST: The replaced and removed values are destroyed once no reader can see them\n");
+
+    destroyed = 0;
+    ReadMostlyMap m = read_mostly_map_create(count_destroyed);
+    ReadMostlyReader reader = read_mostly_reader_create(m);
+    print_test(reader != NULL, "Create a reader of the read mostly map");
+
+    int a = 1, b = 2, c = 3;
+    print_test(read_mostly_map_put(m, "a", &a), "Put the first pair");
+    print_test(read_mostly_map_put(m, "b", &b), "Put the second pair");
+    print_test(read_mostly_map_size(m) == 2, "The amount of stored pairs is correct");
+
+    int *seen = (int*)read_mostly_map_get(reader, "a");
+    print_test(seen == &a, "The reader gets the value of a key");
+
+    print_test(read_mostly_map_put(m, "a", &c), "Update the value of a key");
+    print_test(read_mostly_map_get(reader, "a") == &c, "The new value is seen after the update");
+    print_test(destroyed == 0, "The old value is not destroyed while the reader may still use it");
+    print_test(*seen == 1, "The reader can still use the old value");
+
+    read_mostly_reader_quiescent(reader);
+    print_test(read_mostly_map_remove(m, "b"), "Remove a pair");
+    print_test(destroyed == 1, "The old value is destroyed after the reader declares a quiescent state");
+    print_test(!read_mostly_map_contains(reader, "b"), "The removed key is not contained in the read mostly map");
+
+    read_mostly_reader_offline(reader);
+    print_test(read_mostly_map_put(m, "b", &b), "Put a pair while the reader is offline");
+    print_test(destroyed == 2, "An offline reader does not stop the removed values from being destroyed");
+    print_test(read_mostly_map_get(reader, "a") == NULL && !read_mostly_map_contains(reader, "a"), "An offline reader does not search the read mostly map");
+    read_mostly_reader_online(reader);
+
+    size_t counter = 0;
+    read_mostly_map_for_each(reader, count_pairs, &counter);
+    print_test(counter == 2, "The internal iterator visits every pair");
+
+    read_mostly_reader_destroy(reader);
+    read_mostly_map_destroy(m);
+    print_test(destroyed == 4, "Every value is destroyed with the read mostly map");
+}
+
+static void test_read_mostly_map_many_threads(void) {
+    printf("TEST: Many threads read the keys while a writer updates them\n");
+
+    ReadMostlyMap m = read_mostly_map_create(free);
+    char current_key[10];
+    bool ok = true, done = false;
+
+    for (int i = 0 ; i < KEYS && ok ; i++) {
+        sprintf(current_key, "%d", i);
+        ok = read_mostly_map_put(m, current_key, new_value(i));
+    }
+    print_test(ok, "The pairs are stored correctly");
+
+    pthread_t readers[READERS], writer;
+    ThreadArgs args[READERS + 1];
+    for (int i = 0 ; i <= READERS ; i++) {
+        args[i].map = m;
+        args[i].done = &done;
+        args[i].ok = true;
+    }
+    for (int i = 0 ; i < READERS ; i++) {
+        print_test(pthread_create(&readers[i], NULL, read_keys, &args[i]) == 0, "Create a reader thread");
+    }
+    print_test(pthread_create(&writer, NULL, update_keys, &args[READERS]) == 0, "Create a writer thread");
+
+    pthread_join(writer, NULL);
+    __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+    for (int i = 0 ; i < READERS ; i++) {
+        pthread_join(readers[i], NULL);
+        ok = ok && args[i].ok;
+    }
+    print_test(args[READERS].ok, "The writer updated every pair correctly");
+    print_test(ok, "The readers always found a valid value for every key");
+    print_test(read_mostly_map_size(m) == KEYS, "The amount of stored pairs is correct");
+
+    read_mostly_map_destroy(m);
+}
+
+int main(void) {
+    test_new_read_mostly_map();
+    test_read_mostly_map_retires_values();
+    test_read_mostly_map_many_threads();
+
+    return 0;
+}
+
+void print_test(bool success, const char* msg) {
+    char result[10 + (int)strlen(msg)];
+    sprintf(result, "FAIL: %s\n", msg);
+    assert_msg(success, result);
+}
+
+void *read_keys(void *args) {
+    ThreadArgs* thread_args = (ThreadArgs*)args;
+    ReadMostlyReader reader = read_mostly_reader_create(thread_args->map);
+    char current_key[10];
+
+    thread_args->ok = reader != NULL;
+    while (thread_args->ok && !__atomic_load_n(thread_args->done, __ATOMIC_ACQUIRE)) {
+        for (int i = 0 ; i < KEYS && thread_args->ok ; i++) {
+            sprintf(current_key, "%d", i);
+            int* ptr = (int*)read_mostly_map_get(reader, current_key);
+            thread_args->ok = ptr != NULL && *ptr % KEYS == i;
+        }
+        read_mostly_reader_quiescent(reader);
+    }
+
+    read_mostly_reader_destroy(reader);
+    return NULL;
+}
+
+void *update_keys(void *args) {
+    ThreadArgs* thread_args = (ThreadArgs*)args;
+    char current_key[10];
+
+    for (int i = 0 ; i < UPDATES && thread_args->ok ; i++) {
+        sprintf(current_key, "%d", i % KEYS);
+        thread_args->ok = read_mostly_map_put(thread_args->map, current_key, new_value(i));
+    }
+
+    return NULL;
+}
+
+int *new_value(int value) {
+    int* ptr = (int*)malloc(sizeof(int));
+    if (ptr != NULL) *ptr = value;
+
+    return ptr;
+}
+
+bool count_pairs(const char *key, void *value, void *extra) {
+    *(size_t*)extra += 1;
+    return true;
+}
+
+void count_destroyed(void *value) {
+    destroyed++;
+}